@@ -0,0 +1,400 @@
+#include "animation.h"
+
+#include <string.h>
+#include "config.h"
+#include "crc32.h"
+#include "hardware/flash.h"
+#include "pico/flash.h"
+
+namespace firmware {
+namespace {
+
+// The slot sits just below the settings log. Its first page holds a SlotHeader,
+// written last so a torn upload never looks valid; the image follows.
+constexpr uint32_t ANIMATION_FLASH_OFFSET = PICO_FLASH_SIZE_BYTES - SETTINGS_FLASH_BYTES - ANIMATION_FLASH_BYTES;
+constexpr uint32_t FLASH_IMAGE_OFFSET = ANIMATION_FLASH_OFFSET + FLASH_PAGE_SIZE;
+constexpr uint32_t FLASH_IMAGE_CAPACITY = ANIMATION_FLASH_BYTES - FLASH_PAGE_SIZE;
+constexpr uint32_t ANIMATION_FLASH_TIMEOUT_MS = 100;
+constexpr uint32_t SLOT_MAGIC = 0x4E414150u; // "PAAN"
+// Frames decoded per render at most; a longer stall skips ahead instead.
+constexpr uint32_t MAX_CATCH_UP_FRAMES = 8;
+
+static_assert(ANIMATION_FLASH_BYTES % FLASH_SECTOR_SIZE == 0, "animation slot must be whole sectors");
+static_assert(sizeof(Rgb) == 3, "frames are decoded straight into Rgb arrays");
+
+struct SlotHeader {
+    uint32_t magic;
+    uint32_t size;
+    uint32_t crc;
+};
+
+struct FlashWrite {
+    // 0 skips the erase; the slot never starts at the beginning of flash.
+    uint32_t erase_offset;
+    uint32_t page_offset;
+    // nullptr only erases.
+    const uint8_t* page;
+};
+
+struct Upload {
+    bool active;
+    uint8_t target;
+    uint32_t size;
+    // Flash uploads: bytes received so far, and the page being filled.
+    uint32_t received;
+    uint8_t page[FLASH_PAGE_SIZE];
+};
+
+struct Player {
+    const uint8_t* image;
+    AnimationHeader header;
+    uint32_t first_frame;
+    uint32_t position;
+    uint16_t next_frame;
+    uint32_t elapsed_ms;
+    bool playing;
+    // A non-looping animation past its last frame, which it keeps showing.
+    bool finished;
+};
+
+uint8_t ram_image[ANIMATION_RAM_BYTES];
+bool ram_valid = false;
+// The flash slot is only checksummed once per upload or boot.
+bool flash_checked = false;
+bool flash_valid = false;
+uint8_t newest_target = ANIMATION_TARGET_FLASH;
+
+Upload upload = {};
+Player player = {};
+// Current frame; delta frames are applied on top of it.
+Rgb frame[MAX_LEDS];
+
+const uint8_t* flash_image()
+{
+    return reinterpret_cast<const uint8_t*>(XIP_BASE + FLASH_IMAGE_OFFSET);
+}
+
+uint16_t read_u16(const uint8_t* data)
+{
+    return static_cast<uint16_t>(data[0] | (data[1] << 8));
+}
+
+bool validate_frame(uint8_t type, const uint8_t* data, uint32_t size, uint32_t pixel_count)
+{
+    if (type == ANIMATION_FRAME_RAW) {
+        return size == pixel_count * 3u;
+    }
+
+    uint32_t pixel = 0;
+    uint32_t position = 0;
+    if (type == ANIMATION_FRAME_RLE) {
+        while (position + 4u <= size) {
+            if (data[position] == 0) {
+                return false;
+            }
+            pixel += data[position];
+            position += 4u;
+        }
+        return position == size && pixel == pixel_count;
+    }
+
+    if (type == ANIMATION_FRAME_DELTA) {
+        while (position + 2u <= size) {
+            const uint32_t count = data[position + 1];
+            pixel += data[position] + count;
+            position += 2u + (count * 3u);
+            if (pixel > pixel_count) {
+                return false;
+            }
+        }
+        return position == size;
+    }
+    return false;
+}
+
+// Checks the whole image once so playback can decode without bounds checks.
+bool validate_image(const uint8_t* image, uint32_t size)
+{
+    AnimationHeader header;
+    if (size < sizeof(header)) {
+        return false;
+    }
+    memcpy(&header, image, sizeof(header));
+    if (header.magic[0] != ANIMATION_MAGIC[0] || header.magic[1] != ANIMATION_MAGIC[1]
+        || header.version != ANIMATION_VERSION || header.frame_ms == 0 || header.frame_count == 0
+        || header.pixel_count == 0 || header.pixel_count > MAX_LEDS) {
+        return false;
+    }
+
+    uint32_t position = sizeof(header);
+    for (uint32_t i = 0; i < header.frame_count; i++) {
+        if (size - position < 3u) {
+            return false;
+        }
+        const uint8_t type = image[position];
+        const uint32_t frame_size = read_u16(&image[position + 1]);
+        position += 3u;
+        if (frame_size > size - position || (i == 0 && type == ANIMATION_FRAME_DELTA)
+            || !validate_frame(type, &image[position], frame_size, header.pixel_count)) {
+            LOGF("Animation frame %lu invalid\n", static_cast<unsigned long>(i));
+            return false;
+        }
+        position += frame_size;
+    }
+    return position == size;
+}
+
+bool check_flash_slot()
+{
+    if (!flash_checked) {
+        SlotHeader slot;
+        memcpy(&slot, reinterpret_cast<const void*>(XIP_BASE + ANIMATION_FLASH_OFFSET), sizeof(slot));
+        flash_valid = slot.magic == SLOT_MAGIC && slot.size <= FLASH_IMAGE_CAPACITY
+            && crc32(flash_image(), slot.size) == slot.crc && validate_image(flash_image(), slot.size);
+        flash_checked = true;
+    }
+    return flash_valid;
+}
+
+void flash_write(void* param)
+{
+    const FlashWrite* write = static_cast<const FlashWrite*>(param);
+    if (write->erase_offset != 0) {
+        flash_range_erase(write->erase_offset, FLASH_SECTOR_SIZE);
+    }
+    if (write->page != nullptr) {
+        flash_range_program(write->page_offset, write->page, FLASH_PAGE_SIZE);
+    }
+}
+
+bool run_flash_write(uint32_t erase_offset, uint32_t page_offset, const uint8_t* page)
+{
+    FlashWrite write = {erase_offset, page_offset, page};
+    const int result = flash_safe_execute(flash_write, &write, ANIMATION_FLASH_TIMEOUT_MS);
+    if (result != PICO_OK) {
+        LOGF("Animation flash write failed (%d)\n", result);
+        return false;
+    }
+    return true;
+}
+
+// Programs the upload's page buffer; a page starting a sector erases it first.
+// Sector 0 holds the slot header and was erased by animation_begin().
+bool flush_page()
+{
+    const uint32_t page_offset = FLASH_IMAGE_OFFSET + (((upload.received - 1u) / FLASH_PAGE_SIZE) * FLASH_PAGE_SIZE);
+    const uint32_t erase_offset = ((page_offset - ANIMATION_FLASH_OFFSET) % FLASH_SECTOR_SIZE == 0) ? page_offset : 0;
+    const bool ok = run_flash_write(erase_offset, page_offset, upload.page);
+    memset(upload.page, 0xFF, sizeof(upload.page));
+    return ok;
+}
+
+void decode_frame()
+{
+    const uint8_t* data = &player.image[player.position + 3u];
+    const uint8_t type = player.image[player.position];
+    const uint32_t size = read_u16(&player.image[player.position + 1]);
+    player.position += 3u + size;
+
+    if (type == ANIMATION_FRAME_RAW) {
+        memcpy(frame, data, size);
+        return;
+    }
+
+    uint32_t pixel = 0;
+    if (type == ANIMATION_FRAME_RLE) {
+        for (uint32_t position = 0; position < size; position += 4u) {
+            const Rgb color = {data[position + 1], data[position + 2], data[position + 3]};
+            for (uint32_t end = pixel + data[position]; pixel < end; pixel++) {
+                frame[pixel] = color;
+            }
+        }
+        return;
+    }
+
+    for (uint32_t position = 0; position < size;) {
+        const uint32_t count = data[position + 1];
+        pixel += data[position];
+        memcpy(&frame[pixel], &data[position + 2], count * 3u);
+        pixel += count;
+        position += 2u + (count * 3u);
+    }
+}
+
+// Returns false once a non-looping animation has shown its last frame.
+bool advance()
+{
+    if (player.next_frame == player.header.frame_count) {
+        if ((player.header.flags & ANIMATION_LOOP) == 0) {
+            return false;
+        }
+        player.position = player.first_frame;
+        player.next_frame = 0;
+    }
+    decode_frame();
+    player.next_frame++;
+    return true;
+}
+
+void stop_playing(const uint8_t* image)
+{
+    if (player.image == image) {
+        player.playing = false;
+        player.image = nullptr;
+    }
+}
+
+} // namespace
+
+bool animation_begin(uint8_t target, uint32_t size)
+{
+    upload.active = false;
+    if (target == ANIMATION_TARGET_RAM) {
+        if (size > sizeof(ram_image)) {
+            return false;
+        }
+        stop_playing(ram_image);
+        ram_valid = false;
+    } else if (target == ANIMATION_TARGET_FLASH) {
+        if (size > FLASH_IMAGE_CAPACITY) {
+            return false;
+        }
+        stop_playing(flash_image());
+        flash_checked = true;
+        flash_valid = false;
+        if (!run_flash_write(ANIMATION_FLASH_OFFSET, 0, nullptr)) {
+            return false;
+        }
+        memset(upload.page, 0xFF, sizeof(upload.page));
+    } else {
+        return false;
+    }
+
+    upload.active = true;
+    upload.target = target;
+    upload.size = size;
+    upload.received = 0;
+    return true;
+}
+
+bool animation_write(uint32_t offset, const uint8_t* data, uint16_t size)
+{
+    if (!upload.active || offset > upload.size || size > upload.size - offset) {
+        return false;
+    }
+    if (upload.target == ANIMATION_TARGET_RAM) {
+        memcpy(&ram_image[offset], data, size);
+        return true;
+    }
+
+    if (offset != upload.received) {
+        LOGF("Animation chunk at %lu out of order\n", static_cast<unsigned long>(offset));
+        upload.active = false;
+        return false;
+    }
+    for (uint16_t i = 0; i < size; i++) {
+        upload.page[upload.received % FLASH_PAGE_SIZE] = data[i];
+        upload.received++;
+        if (upload.received % FLASH_PAGE_SIZE == 0 && !flush_page()) {
+            upload.active = false;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool animation_end(uint32_t crc)
+{
+    if (!upload.active) {
+        return false;
+    }
+    upload.active = false;
+
+    if (upload.target == ANIMATION_TARGET_RAM) {
+        ram_valid = crc32(ram_image, upload.size) == crc && validate_image(ram_image, upload.size);
+        if (ram_valid) {
+            newest_target = ANIMATION_TARGET_RAM;
+        }
+        return ram_valid;
+    }
+
+    if (upload.received != upload.size
+        || (upload.received % FLASH_PAGE_SIZE != 0 && !flush_page())
+        || crc32(flash_image(), upload.size) != crc || !validate_image(flash_image(), upload.size)) {
+        return false;
+    }
+
+    uint8_t page[FLASH_PAGE_SIZE];
+    memset(page, 0xFF, sizeof(page));
+    const SlotHeader slot = {SLOT_MAGIC, upload.size, crc};
+    memcpy(page, &slot, sizeof(slot));
+    if (!run_flash_write(0, ANIMATION_FLASH_OFFSET, page)) {
+        return false;
+    }
+    flash_valid = true;
+    newest_target = ANIMATION_TARGET_FLASH;
+    return true;
+}
+
+bool animation_flash_valid()
+{
+    return check_flash_slot();
+}
+
+void animation_start()
+{
+    player.playing = false;
+    player.image = nullptr;
+    const bool use_ram = ram_valid && (newest_target == ANIMATION_TARGET_RAM || !check_flash_slot());
+    if (use_ram) {
+        player.image = ram_image;
+    } else if (check_flash_slot()) {
+        player.image = flash_image();
+    } else {
+        LOGF("Animation: nothing to play\n");
+        return;
+    }
+
+    memcpy(&player.header, player.image, sizeof(player.header));
+    player.first_frame = sizeof(AnimationHeader);
+    player.position = player.first_frame;
+    player.next_frame = 0;
+    player.elapsed_ms = 0;
+    player.playing = true;
+    player.finished = false;
+    advance();
+}
+
+bool animation_finished()
+{
+    return !player.playing || player.finished;
+}
+
+void animation_render(uint32_t dt_ms, PixelSpan pixels)
+{
+    if (!player.playing) {
+        memset(pixels.data, 0, pixels.count * sizeof(Rgb));
+        return;
+    }
+
+    const uint32_t frame_ms = player.header.frame_ms;
+    player.elapsed_ms += dt_ms;
+    for (uint32_t decoded = 0; player.elapsed_ms >= frame_ms; decoded++) {
+        if (decoded == MAX_CATCH_UP_FRAMES) {
+            player.elapsed_ms %= frame_ms;
+            break;
+        }
+        player.elapsed_ms -= frame_ms;
+        if (!advance()) {
+            player.elapsed_ms = 0;
+            player.finished = true;
+            break;
+        }
+    }
+
+    const uint16_t shown = (player.header.pixel_count < pixels.count) ? player.header.pixel_count : pixels.count;
+    memcpy(pixels.data, frame, shown * sizeof(Rgb));
+    memset(&pixels.data[shown], 0, (pixels.count - shown) * sizeof(Rgb));
+}
+
+} // namespace firmware
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdint.h>
+#include "led_driver.h"
+
+namespace firmware {
+
+// Uploaded keyframe animations, played by EFFECT_MODE_ANIMATION without the host.
+//
+// Image layout (little-endian): a header, then frame_count frames of
+// [type][size u16][data]. The first frame must be a keyframe.
+//   RAW:   pixel_count x R,G,B.
+//   RLE:   runs of [length 1-255][R][G][B] covering exactly pixel_count pixels.
+//   DELTA: runs of [skip][count][count x R,G,B] over the previous frame; an empty
+//          delta holds the previous frame.
+struct AnimationHeader {
+    uint8_t magic[2];
+    uint8_t version;
+    uint8_t flags;
+    uint16_t frame_ms;
+    uint16_t pixel_count;
+    uint16_t frame_count;
+    uint16_t reserved;
+};
+
+static_assert(sizeof(AnimationHeader) == 12, "animation header is part of the wire format");
+
+constexpr uint8_t ANIMATION_MAGIC[2] = {'P', 'A'};
+constexpr uint8_t ANIMATION_VERSION = 1;
+
+enum AnimationFlags : uint8_t {
+    // Restart from the first frame instead of holding the last one.
+    ANIMATION_LOOP = 0x01,
+};
+
+enum AnimationFrameType : uint8_t {
+    ANIMATION_FRAME_RAW = 0,
+    ANIMATION_FRAME_RLE = 1,
+    ANIMATION_FRAME_DELTA = 2,
+};
+
+// Where an upload is stored. The flash slot survives a reboot and is played when
+// no RAM animation has been uploaded since.
+enum AnimationTarget : uint8_t {
+    ANIMATION_TARGET_RAM = 0,
+    ANIMATION_TARGET_FLASH = 1,
+};
+
+// Upload, in order: begin, any number of data chunks, end. Chunks for the flash slot
+// must arrive in order; RAM chunks may come in any order. Returns false when the
+// upload was rejected; a failed end leaves no playable animation in the target.
+bool animation_begin(uint8_t target, uint32_t size);
+bool animation_write(uint32_t offset, const uint8_t* data, uint16_t size);
+bool animation_end(uint32_t crc);
+
+// True when the flash slot holds a valid animation, the one played after a reboot.
+// Render core only.
+bool animation_flash_valid();
+
+// Restarts playback from the newest valid animation. Render core only.
+void animation_start();
+// True when nothing is playing or a non-looping animation has shown its last frame:
+// the rendered frame no longer changes. Render core only.
+bool animation_finished();
+// Advances playback by dt_ms and copies the current frame into `pixels`. Pixels past
+// the animation's length are cleared.
+void animation_render(uint32_t dt_ms, PixelSpan pixels);
+
+} // namespace firmware
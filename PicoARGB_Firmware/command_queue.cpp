@@ -0,0 +1,95 @@
+#include "command_queue.h"
+
+#include "hardware/sync.h"
+
+namespace firmware {
+namespace {
+
+constexpr uint32_t COMMAND_QUEUE_DEPTH = 32;
+static_assert((COMMAND_QUEUE_DEPTH & (COMMAND_QUEUE_DEPTH - 1)) == 0, "queue depth must be a power of two");
+
+HostCommand slots[COMMAND_QUEUE_DEPTH];
+// head is only written by the producer and tail only by the consumer.
+volatile uint32_t head = 0;
+volatile uint32_t tail = 0;
+volatile uint32_t dropped = 0;
+
+uint8_t frame_stage[FRAME_STAGE_BYTES];
+// Set by the producer on handoff and cleared by the consumer on release.
+volatile bool stage_held = false;
+
+} // namespace
+
+HostCommand* command_queue_reserve()
+{
+    if (head - tail >= COMMAND_QUEUE_DEPTH) {
+        dropped = dropped + 1;
+        return nullptr;
+    }
+    return &slots[head & (COMMAND_QUEUE_DEPTH - 1)];
+}
+
+bool command_queue_full()
+{
+    return head - tail >= COMMAND_QUEUE_DEPTH;
+}
+
+void command_queue_commit()
+{
+    // Publish the slot contents before the new head becomes visible to core 1.
+    __mem_fence_release();
+    head = head + 1;
+    __sev();
+}
+
+const HostCommand* command_queue_front()
+{
+    if (tail == head) {
+        return nullptr;
+    }
+    __mem_fence_acquire();
+    return &slots[tail & (COMMAND_QUEUE_DEPTH - 1)];
+}
+
+void command_queue_pop()
+{
+    __mem_fence_release();
+    tail = tail + 1;
+    // A producer waiting for a free slot sleeps in WFE.
+    __sev();
+}
+
+uint32_t command_queue_dropped()
+{
+    return dropped;
+}
+
+uint8_t* command_queue_stage()
+{
+    if (stage_held) {
+        return nullptr;
+    }
+    // The consumer is done reading before the producer writes again.
+    __mem_fence_acquire();
+    return frame_stage;
+}
+
+void command_queue_stage_handoff()
+{
+    // The stage contents are published by the commit of the command carrying it.
+    stage_held = true;
+}
+
+const uint8_t* command_queue_staged()
+{
+    return frame_stage;
+}
+
+void command_queue_stage_release()
+{
+    __mem_fence_release();
+    stage_held = false;
+    __sev();
+}
+
+} // namespace firmware
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <stdint.h>
+#include "config.h"
+
+namespace firmware {
+
+// Single-producer/single-consumer ring carrying host commands from the USB core
+// (core 0) to the render core (core 1). Slots are filled and consumed in place.
+constexpr uint16_t HOST_COMMAND_PAYLOAD_MAX = 63;
+
+struct HostCommand {
+    uint8_t command;
+    uint8_t payload_size;
+    uint8_t payload[HOST_COMMAND_PAYLOAD_MAX];
+};
+
+// Producer side: returns nullptr (and counts a drop) when the ring is full.
+HostCommand* command_queue_reserve();
+bool command_queue_full();
+void command_queue_commit();
+
+// Consumer side: returns nullptr when the ring is empty.
+const HostCommand* command_queue_front();
+void command_queue_pop();
+
+uint32_t command_queue_dropped();
+
+// A whole streamed frame of R,G,B triplets, handed to the render core with a single
+// queued command instead of one slot per few pixels. The producer fills it while
+// command_queue_stage() returns it and calls command_queue_stage_handoff() before
+// committing the command that carries it; the consumer reads command_queue_staged()
+// and calls command_queue_stage_release() when done.
+constexpr uint32_t FRAME_STAGE_BYTES = MAX_LEDS * 3;
+
+// Producer side: nullptr while the consumer still holds the last frame.
+uint8_t* command_queue_stage();
+void command_queue_stage_handoff();
+
+const uint8_t* command_queue_staged();
+void command_queue_stage_release();
+
+} // namespace firmware
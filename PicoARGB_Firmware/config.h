@@ -5,22 +5,61 @@
 #include "pico/stdlib.h"
 
 // Main firmware parameters. Keep these pins stable for the current hardware.
+#ifndef DEBUG_LOG
 #define DEBUG_LOG 1
+#endif
+// Default output gamma: 1 starts at gamma 2.0, 0 linear. SET_CALIBRATION overrides it
+// per channel at runtime.
 #define ENABLE_GAMMA 1
+// Run clk_sys from the 48 MHz USB PLL and stop the system PLL while idle.
+#ifndef ENABLE_IDLE_UNDERCLOCK
+#define ENABLE_IDLE_UNDERCLOCK 1
+#endif
 
 namespace firmware {
 
 constexpr uint WS2812_PIN = 0;
 constexpr uint DEBUG_LED_PIN = 25;
-constexpr uint NUM_LEDS = 8;
+
+// Parallel WS2812 outputs, spread over the state machines of pio0 and pio1.
+// Output 0 is the original ARGB header on WS2812_PIN.
+constexpr uint MAX_OUTPUT_CHANNELS = 8;
+constexpr uint OUTPUT_CHANNEL_PINS[MAX_OUTPUT_CHANNELS] = {WS2812_PIN, 1, 2, 3, 4, 5, 6, 7};
+// Pixel arena capacity; the active length is set at runtime over HID.
+constexpr uint MAX_LEDS = 1024;
+constexpr uint16_t DEFAULT_NUM_LEDS = 8;
 
 // Do not change VID/PID without updating the host-side controller.
 constexpr uint16_t USB_VID = 0x20A0;
 constexpr uint16_t USB_PID = 0x423D;
 
 constexpr uint8_t DEFAULT_BRIGHTNESS = 100;
+// Output gamma exponent in tenths until the host uploads a calibration.
+constexpr uint8_t DEFAULT_GAMMA_TENTHS = ENABLE_GAMMA ? 20 : 10;
 constexpr uint8_t DEFAULT_EFFECT_SPEED = 100;
-constexpr uint32_t EFFECT_FRAME_MS = 16;
+// Current model of the power limiter until the host uploads one (WS2812B): mA per
+// channel at full duty, and the draw of a dark LED in tenths of mA.
+constexpr uint8_t DEFAULT_CHANNEL_MA = 12;
+constexpr uint8_t DEFAULT_IDLE_TENTHS_MA = 6;
+// Frames are paced by the frame scheduler at one of these rates, set over HID.
+constexpr uint16_t FRAME_RATES[] = {30, 60, 120, 240};
+constexpr uint16_t DEFAULT_FRAME_RATE = 60;
+// While frames cannot change (OFF, STATIC), the render core only wakes this often
+// for the keep-alive refresh and pending settings writes, plus on host commands.
+constexpr uint32_t IDLE_WAKE_MS = 100;
+// Longest the USB core sleeps between interrupts, for its own timers.
+constexpr uint32_t USB_WAKE_MS = 1;
+// Unchanged frames are not re-sent, except once per this interval so a pixel
+// corrupted by line noise recovers. 0 only sends frames that changed.
+constexpr uint32_t LED_KEEPALIVE_MS = 1000;
+// Settings are written to flash once they have been stable this long.
+constexpr uint32_t SETTINGS_WRITE_DELAY_MS = 2000;
+
+// Flash layout, from the end of flash: the settings log, then the animation slot.
+constexpr uint32_t SETTINGS_FLASH_BYTES = 8 * 1024;
+constexpr uint32_t ANIMATION_FLASH_BYTES = 64 * 1024;
+// Uploaded animations played from RAM.
+constexpr uint32_t ANIMATION_RAM_BYTES = 32 * 1024;
 
 void debug_init();
 void debug_service(uint32_t now_ms);
@@ -31,5 +70,5 @@ void debug_blink(uint8_t count, uint16_t on_ms, uint16_t off_ms = 0);
 #if DEBUG_LOG
 #define LOGF(...) printf(__VA_ARGS__)
 #else
-#define LOGF(...) do { } while (0)
+#define LOGF(...) do { if (0) printf(__VA_ARGS__); } while (0)
 #endif
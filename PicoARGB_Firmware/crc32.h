@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stdint.h>
+
+namespace firmware {
+
+// Bitwise CRC-32 (IEEE, reflected). Only used on writes and validation, so no table.
+inline uint32_t crc32(const uint8_t* data, uint32_t size)
+{
+    uint32_t crc = 0xFFFFFFFFu;
+    for (uint32_t i = 0; i < size; i++) {
+        crc ^= data[i];
+        for (uint32_t bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+        }
+    }
+    return ~crc;
+}
+
+} // namespace firmware
@@ -1,7 +1,10 @@
 #include "effects.h"
 
-#include <math.h>
+#include "animation.h"
 #include "config.h"
+#include "fixed_math.h"
+#include "pixel_program.h"
+#include "telemetry.h"
 
 namespace firmware {
 
@@ -17,13 +20,30 @@ enum class SystemAnimation : uint8_t {
 
 uint8_t current_mode = EFFECT_MODE_MUSIC_VU;
 uint8_t music_level = 0;
-float music_envelope = 0.0f;
+// Envelope of the music level in Q16 (0..255 << 16).
+uint32_t music_envelope = 0;
 uint8_t music_style = MUSIC_STYLE_INTENSITY_WHEEL;
+uint16_t frame_rate = DEFAULT_FRAME_RATE;
 
 constexpr Rgb SAFE_DEFAULT_BASE_COLOR = {0, 64, 96};
 constexpr uint8_t MUSIC_NOISE_GATE = 6;
-constexpr float MUSIC_IDLE_GLOW = 0.0f;
-constexpr float MUSIC_BLACK_THRESHOLD = 0.5f;
+constexpr uint32_t MUSIC_IDLE_GLOW = to_q16(0.0);
+constexpr uint32_t MUSIC_BLACK_THRESHOLD = to_q16(0.5);
+constexpr uint32_t MUSIC_ATTACK_PER_MS = Q16_ONE / 125;
+constexpr uint32_t MUSIC_RELEASE_PER_MS = Q16_ONE / 620;
+// Bands move faster than the overall level so bars keep up with individual hits.
+constexpr uint32_t SPECTRUM_ATTACK_PER_MS = Q16_ONE / 40;
+constexpr uint32_t SPECTRUM_RELEASE_PER_MS = Q16_ONE / 300;
+constexpr uint32_t CONNECTION_ANIMATION_MS = 1200;
+
+// Effect rates at 100% speed, as Q32 turns (or Q16 LEDs) per millisecond.
+constexpr uint32_t RAINBOW_RATE = turns_per_ms_from_degrees(0.045);
+constexpr uint32_t COLOR_CYCLE_RATE = turns_per_ms_from_degrees(0.018);
+constexpr uint32_t BREATH_RATE = turns_per_ms_from_radians(0.0035);
+constexpr uint32_t CHASE_GLOW_RATE = turns_per_ms_from_radians(0.008);
+constexpr uint32_t CHASE_STEP_RATE = to_q16(0.006);
+
+constexpr detail::CurveTable MUSIC_WHEEL_CURVE = detail::make_power_table(0.65);
 
 Rgb base_color = SAFE_DEFAULT_BASE_COLOR;
 bool host_color_received = false;
@@ -33,73 +53,57 @@ uint32_t animation_started_ms = 0;
 uint32_t last_frame_ms = 0;
 uint32_t last_animation_step = 0xffffffffu;
 
-float rainbow_hue = 0.0f;
-float breath_phase = 0.0f;
-float chase_position = 0.0f;
-float chase_glow = 0.0f;
-float cycle_hue = 0.0f;
-
-float speed_scale()
-{
-    return static_cast<float>(effect_speed) / 100.0f;
-}
+uint8_t spectrum_levels[MAX_SPECTRUM_BANDS] = {};
+// Per-band envelopes in Q16 (0..255 << 16).
+uint32_t spectrum_envelopes[MAX_SPECTRUM_BANDS] = {};
+uint8_t spectrum_bands = 0;
+// audio_meter_color() sampled at 256 heights for the per-pixel bar gradient.
+Rgb meter_gradient[256] = {};
+
+// Animation state of one running effect, so the same effect can run on several layers.
+struct EffectState {
+    uint32_t phase;
+    uint32_t glow;
+    uint32_t position;
+};
 
-float clamp01(float value)
-{
-    if (value < 0.0f) {
-        return 0.0f;
-    }
-    if (value > 1.0f) {
-        return 1.0f;
-    }
-    return value;
-}
+// Inputs of one running effect: the base mode uses the global color and speed,
+// zones can carry their own.
+struct EffectParams {
+    Rgb color;
+    uint8_t speed;
+    bool color_set;
+};
 
-Rgb scale_color(Rgb color, float intensity)
-{
-    const float safe = clamp01(intensity);
-    return {
-        static_cast<uint8_t>(color.r * safe),
-        static_cast<uint8_t>(color.g * safe),
-        static_cast<uint8_t>(color.b * safe),
-    };
-}
+EffectState base_state = {};
 
-uint8_t lerp_u8(uint8_t a, uint8_t b, float t)
+// Step for dt_ms at a speed in percent; the rates are given at 100%.
+uint32_t speed_step(uint32_t dt_ms, uint32_t rate, uint8_t speed)
 {
-    return static_cast<uint8_t>(static_cast<float>(a) + ((static_cast<float>(b) - static_cast<float>(a)) * clamp01(t)));
+    return static_cast<uint32_t>((static_cast<uint64_t>(rate) * dt_ms * speed) / 100u);
 }
 
-Rgb lerp_color(Rgb a, Rgb b, float t)
-{
-    return {
-        lerp_u8(a.r, b.r, t),
-        lerp_u8(a.g, b.g, t),
-        lerp_u8(a.b, b.b, t),
-    };
-}
-
-Rgb audio_meter_color(float level)
+Rgb audio_meter_color(uint32_t level)
 {
     struct Stop {
-        float at;
+        uint32_t at;
         Rgb color;
     };
 
     constexpr Stop stops[] = {
-        {0.00f, {60, 100, 220}},
-        {0.22f, {0, 190, 255}},
-        {0.45f, {0, 245, 150}},
-        {0.68f, {235, 255, 40}},
-        {0.84f, {255, 120, 18}},
-        {1.00f, {255, 20, 0}},
+        {to_q16(0.00), {60, 100, 220}},
+        {to_q16(0.22), {0, 190, 255}},
+        {to_q16(0.45), {0, 245, 150}},
+        {to_q16(0.68), {235, 255, 40}},
+        {to_q16(0.84), {255, 120, 18}},
+        {to_q16(1.00), {255, 20, 0}},
     };
 
-    const float safe = clamp01(level);
+    const uint32_t safe = (level > Q16_ONE) ? Q16_ONE : level;
     for (uint i = 1; i < sizeof(stops) / sizeof(stops[0]); i++) {
         if (safe <= stops[i].at) {
-            const float span = stops[i].at - stops[i - 1].at;
-            const float t = (span <= 0.0f) ? 1.0f : (safe - stops[i - 1].at) / span;
+            const uint32_t span = stops[i].at - stops[i - 1].at;
+            const uint32_t t = (span == 0) ? Q16_ONE : ((safe - stops[i - 1].at) << 16) / span;
             return lerp_color(stops[i - 1].color, stops[i].color, t);
         }
     }
@@ -107,209 +111,586 @@ Rgb audio_meter_color(float level)
     return stops[sizeof(stops) / sizeof(stops[0]) - 1].color;
 }
 
-Rgb hsv_to_rgb(float hue, float saturation, float value)
-{
-    while (hue >= 360.0f) {
-        hue -= 360.0f;
-    }
-    while (hue < 0.0f) {
-        hue += 360.0f;
-    }
-
-    const float c = value * saturation;
-    const float x = c * (1.0f - fabsf(fmodf(hue / 60.0f, 2.0f) - 1.0f));
-    const float m = value - c;
-
-    float r = 0.0f;
-    float g = 0.0f;
-    float b = 0.0f;
-
-    if (hue < 60.0f) {
-        r = c; g = x; b = 0.0f;
-    } else if (hue < 120.0f) {
-        r = x; g = c; b = 0.0f;
-    } else if (hue < 180.0f) {
-        r = 0.0f; g = c; b = x;
-    } else if (hue < 240.0f) {
-        r = 0.0f; g = x; b = c;
-    } else if (hue < 300.0f) {
-        r = x; g = 0.0f; b = c;
-    } else {
-        r = c; g = 0.0f; b = x;
-    }
-
-    return {
-        static_cast<uint8_t>((r + m) * 255.0f),
-        static_cast<uint8_t>((g + m) * 255.0f),
-        static_cast<uint8_t>((b + m) * 255.0f),
-    };
-}
+// Static modes only render when this is set; animated modes render every frame.
+bool static_frame_dirty = true;
 
 void cancel_system_animation()
 {
     system_animation = SystemAnimation::None;
     last_animation_step = 0xffffffffu;
+    static_frame_dirty = true;
 }
 
-void render_static()
+void fill_pixels(PixelSpan pixels, Rgb color)
 {
-    if (!host_color_received) {
-        led_clear();
-        return;
+    for (uint i = 0; i < pixels.count; i++) {
+        pixels.data[i] = color;
     }
+}
 
-    led_fill(base_color);
-    led_show();
+void reset_music()
+{
+    music_level = 0;
+    music_envelope = 0;
 }
 
-void render_rainbow(float dt_ms)
+void reset_spectrum()
 {
-    rainbow_hue = fmodf(rainbow_hue + (dt_ms * 0.045f * speed_scale()), 360.0f);
-    for (uint i = 0; i < NUM_LEDS; i++) {
-        const float led_hue = rainbow_hue + (static_cast<float>(i) * 360.0f / NUM_LEDS);
-        led_set_pixel(i, hsv_to_rgb(led_hue, 1.0f, 1.0f));
+    for (uint i = 0; i < MAX_SPECTRUM_BANDS; i++) {
+        spectrum_levels[i] = 0;
+        spectrum_envelopes[i] = 0;
     }
-    led_show();
 }
 
-void render_breathing(float dt_ms)
+void render_off(EffectState& state, const EffectParams& params, uint32_t dt_ms, PixelSpan pixels)
+{
+    (void)state;
+    (void)params;
+    (void)dt_ms;
+    fill_pixels(pixels, {0, 0, 0});
+}
+
+void render_static(EffectState& state, const EffectParams& params, uint32_t dt_ms, PixelSpan pixels)
 {
-    breath_phase += dt_ms * 0.0035f * speed_scale();
-    const float raw = (sinf(breath_phase) + 1.0f) * 0.5f;
-    const float eased = raw * raw * (3.0f - 2.0f * raw);
-    led_fill(scale_color(base_color, eased));
-    led_show();
+    (void)state;
+    (void)dt_ms;
+    fill_pixels(pixels, params.color_set ? params.color : Rgb{0, 0, 0});
 }
 
-void render_chase(float dt_ms)
+void render_rainbow(EffectState& state, const EffectParams& params, uint32_t dt_ms, PixelSpan pixels)
 {
-    chase_position = fmodf(chase_position + dt_ms * 0.006f * speed_scale(), static_cast<float>(NUM_LEDS));
-    chase_glow += dt_ms * 0.008f * speed_scale();
+    state.phase += speed_step(dt_ms, RAINBOW_RATE, params.speed);
+    const uint32_t hue_step = static_cast<uint32_t>(0x100000000ull / pixels.count);
+    uint32_t hue = state.phase;
+    for (uint i = 0; i < pixels.count; i++) {
+        pixels.data[i] = hsv_to_rgb(static_cast<uint16_t>(hue >> 16), 255, 255);
+        hue += hue_step;
+    }
+}
 
-    for (uint i = 0; i < NUM_LEDS; i++) {
-        float dist = fabsf(static_cast<float>(i) - chase_position);
-        if (dist > NUM_LEDS / 2.0f) {
-            dist = NUM_LEDS - dist;
+void render_breathing(EffectState& state, const EffectParams& params, uint32_t dt_ms, PixelSpan pixels)
+{
+    state.phase += speed_step(dt_ms, BREATH_RATE, params.speed);
+    const uint32_t raw = static_cast<uint32_t>(sin_q15(state.phase) + 32768);
+    const uint32_t eased = mul_q16(mul_q16(raw, raw), (3u * Q16_ONE) - (2u * raw));
+    fill_pixels(pixels, scale_color(params.color, eased));
+}
+
+void render_chase(EffectState& state, const EffectParams& params, uint32_t dt_ms, PixelSpan pixels)
+{
+    const uint32_t length = static_cast<uint32_t>(pixels.count) << 16;
+    state.position = (state.position + speed_step(dt_ms, CHASE_STEP_RATE, params.speed)) % length;
+    state.glow += speed_step(dt_ms, CHASE_GLOW_RATE, params.speed);
+
+    const uint32_t glow = static_cast<uint32_t>(to_q16(0.82) + ((static_cast<int32_t>(to_q16(0.18)) * sin_q15(state.glow)) >> 15));
+    const uint32_t head = mul_q16(to_q16(1.00), glow);
+    const uint32_t near = mul_q16(to_q16(0.55), glow);
+    const uint32_t tail = mul_q16(to_q16(0.22), glow);
+
+    for (uint i = 0; i < pixels.count; i++) {
+        const uint32_t pixel = static_cast<uint32_t>(i) << 16;
+        uint32_t dist = (pixel > state.position) ? pixel - state.position : state.position - pixel;
+        if (dist > length / 2u) {
+            dist = length - dist;
         }
 
-        float intensity = 0.0f;
-        if (dist < 0.5f) {
-            intensity = 1.0f;
-        } else if (dist < 1.5f) {
-            intensity = 0.55f;
-        } else if (dist < 2.5f) {
-            intensity = 0.22f;
+        uint32_t intensity = 0;
+        if (dist < to_q16(0.5)) {
+            intensity = head;
+        } else if (dist < to_q16(1.5)) {
+            intensity = near;
+        } else if (dist < to_q16(2.5)) {
+            intensity = tail;
         }
+        pixels.data[i] = scale_color(params.color, intensity);
+    }
+}
 
-        intensity *= 0.82f + (0.18f * sinf(chase_glow));
-        led_set_pixel(i, scale_color(base_color, intensity));
+// Attack/release follower towards a gated level, shared by the level meter and the
+// spectrum bands. Envelopes are Q16 (0..255 << 16).
+uint32_t follow_envelope(uint32_t envelope, uint8_t level, uint32_t dt_ms, uint32_t attack, uint32_t release)
+{
+    const uint32_t target = (level <= MUSIC_NOISE_GATE) ? 0u : static_cast<uint32_t>(level) << 16;
+    const uint32_t rate = (target > envelope) ? attack : release;
+    const uint32_t alpha = (dt_ms >= Q16_ONE / rate) ? Q16_ONE : dt_ms * rate;
+    const int64_t delta = static_cast<int64_t>(target) - static_cast<int64_t>(envelope);
+    envelope = static_cast<uint32_t>(static_cast<int64_t>(envelope) + ((delta * alpha) >> 16));
+    if (envelope < MUSIC_BLACK_THRESHOLD && target == 0) {
+        envelope = 0;
     }
-    led_show();
+    return envelope;
+}
+
+void update_music_envelope(uint32_t dt_ms)
+{
+    music_envelope = follow_envelope(music_envelope, music_level, dt_ms, MUSIC_ATTACK_PER_MS, MUSIC_RELEASE_PER_MS);
 }
 
-void update_music_envelope(float dt_ms)
+void update_spectrum_envelopes(uint32_t dt_ms)
 {
-    const float target = (music_level <= MUSIC_NOISE_GATE) ? 0.0f : static_cast<float>(music_level);
-    const float time_constant = (target > music_envelope) ? 125.0f : 620.0f;
-    const float alpha = clamp01(dt_ms / time_constant);
-    music_envelope += (target - music_envelope) * alpha;
-    if (music_envelope < MUSIC_BLACK_THRESHOLD && target == 0.0f) {
-        music_envelope = 0.0f;
+    for (uint band = 0; band < spectrum_bands; band++) {
+        spectrum_envelopes[band] = follow_envelope(spectrum_envelopes[band], spectrum_levels[band], dt_ms,
+            SPECTRUM_ATTACK_PER_MS, SPECTRUM_RELEASE_PER_MS);
     }
 }
 
-void render_music_vu(float dt_ms)
+// Q16 0..1 from a 0..255 << 16 envelope.
+uint32_t envelope_level(uint32_t envelope)
 {
-    update_music_envelope(dt_ms);
+    return (envelope >= (255u << 16)) ? Q16_ONE : envelope / 255u;
+}
+
+void render_music_vu(EffectState& state, const EffectParams& params, uint32_t dt_ms, PixelSpan pixels)
+{
+    (void)state;
+    (void)dt_ms;
 
     if (music_envelope <= MUSIC_BLACK_THRESHOLD) {
-        led_clear();
+        fill_pixels(pixels, {0, 0, 0});
         return;
     }
 
-    const float level = clamp01(music_envelope / 255.0f);
+    const uint32_t level = envelope_level(music_envelope);
     if (music_style == MUSIC_STYLE_PULSE_BASE_COLOR) {
-        const float intensity = MUSIC_IDLE_GLOW + ((1.0f - MUSIC_IDLE_GLOW) * level * level);
-        for (uint i = 0; i < NUM_LEDS; i++) {
-            led_set_pixel(i, scale_color(base_color, intensity));
-        }
-        led_show();
+        const uint32_t intensity = MUSIC_IDLE_GLOW + mul_q16(Q16_ONE - MUSIC_IDLE_GLOW, mul_q16(level, level));
+        fill_pixels(pixels, scale_color(params.color, intensity));
         return;
     }
 
     const Rgb color = audio_meter_color(level);
-    const float intensity = 0.08f + (0.92f * powf(level, 0.65f));
-    const Rgb lit_color = scale_color(color, intensity);
+    const uint32_t intensity = to_q16(0.08) + mul_q16(to_q16(0.92), curve_q16(MUSIC_WHEEL_CURVE, level));
+    fill_pixels(pixels, scale_color(color, intensity));
+}
+
+// The strip is split evenly between the bands; each bar grows from the start of its
+// segment, colored by height, with a partially lit top pixel.
+void render_spectrum_bars(EffectState& state, const EffectParams& params, uint32_t dt_ms, PixelSpan pixels)
+{
+    (void)state;
+    (void)params;
+    (void)dt_ms;
+    if (spectrum_bands == 0) {
+        fill_pixels(pixels, {0, 0, 0});
+        return;
+    }
+
+    for (uint band = 0; band < spectrum_bands; band++) {
+        const uint start = (band * pixels.count) / spectrum_bands;
+        const uint end = ((band + 1) * pixels.count) / spectrum_bands;
+        const uint32_t length = end - start;
+        if (length == 0) {
+            continue;
+        }
 
-    for (uint i = 0; i < NUM_LEDS; i++) {
-        led_set_pixel(i, lit_color);
+        const uint32_t height = envelope_level(spectrum_envelopes[band]) * length;
+        const uint32_t step = Q16_ONE / length;
+        uint32_t position = 0;
+        for (uint i = start; i < end; i++) {
+            const uint32_t lit_from = (i - start) << 16;
+            uint32_t intensity = 0;
+            if (height >= lit_from + Q16_ONE) {
+                intensity = Q16_ONE;
+            } else if (height > lit_from) {
+                intensity = height - lit_from;
+            }
+            pixels.data[i] = (intensity == 0) ? Rgb{0, 0, 0} : scale_color(meter_gradient[position >> 8], intensity);
+            position += step;
+        }
     }
-    led_show();
 }
 
-void render_color_cycle(float dt_ms)
+// Each band gets a color from its envelope; LEDs blend the two nearest bands.
+void render_spectrum(EffectState& state, const EffectParams& params, uint32_t dt_ms, PixelSpan pixels)
 {
-    cycle_hue = fmodf(cycle_hue + (dt_ms * 0.018f * speed_scale()), 360.0f);
-    led_fill(hsv_to_rgb(cycle_hue, 1.0f, 1.0f));
-    led_show();
+    (void)state;
+    (void)params;
+    (void)dt_ms;
+    if (spectrum_bands == 0) {
+        fill_pixels(pixels, {0, 0, 0});
+        return;
+    }
+
+    Rgb band_colors[MAX_SPECTRUM_BANDS];
+    for (uint band = 0; band < spectrum_bands; band++) {
+        const uint32_t level = envelope_level(spectrum_envelopes[band]);
+        const uint32_t intensity = to_q16(0.08) + mul_q16(to_q16(0.92), curve_q16(MUSIC_WHEEL_CURVE, level));
+        band_colors[band] = (level == 0) ? Rgb{0, 0, 0} : scale_color(audio_meter_color(level), intensity);
+    }
+
+    const uint32_t last_band = spectrum_bands - 1u;
+    const uint32_t step = (pixels.count > 1) ? (last_band << 16) / (pixels.count - 1u) : 0;
+    uint32_t position = 0;
+    for (uint i = 0; i < pixels.count; i++) {
+        const uint32_t band = position >> 16;
+        const uint32_t next = (band < last_band) ? band + 1 : band;
+        pixels.data[i] = lerp_color(band_colors[band], band_colors[next], position & 0xFFFFu);
+        position += step;
+    }
 }
 
-bool render_system_animation(uint32_t now_ms)
+void render_color_cycle(EffectState& state, const EffectParams& params, uint32_t dt_ms, PixelSpan pixels)
 {
-    if (system_animation == SystemAnimation::None) {
-        return false;
+    state.phase += speed_step(dt_ms, COLOR_CYCLE_RATE, params.speed);
+    fill_pixels(pixels, hsv_to_rgb(static_cast<uint16_t>(state.phase >> 16), 255, 255));
+}
+
+// Program time is in Q16 seconds and runs at the effect speed.
+void render_program(EffectState& state, const EffectParams& params, uint32_t dt_ms, PixelSpan pixels)
+{
+    state.phase += static_cast<uint32_t>((static_cast<uint64_t>(dt_ms) * params.speed * Q16_ONE) / 100000u);
+    const ProgramInputs inputs = {state.phase, envelope_level(music_envelope),
+        params.color_set ? params.color : Rgb{0, 0, 0}};
+    program_render(inputs, pixels);
+}
+
+void render_animation(EffectState& state, const EffectParams& params, uint32_t dt_ms, PixelSpan pixels)
+{
+    (void)state;
+    (void)params;
+    animation_render(dt_ms, pixels);
+}
+
+// One entry per EffectMode, indexed by mode. Renderers only write pixels;
+// effects_update() issues the single led_show() per frame. Static effects are
+// re-rendered only after something they depend on changed. A null renderer leaves
+// the pixels to the host.
+struct EffectDescriptor {
+    uint8_t mode;
+    void (*init)();
+    void (*render)(EffectState& state, const EffectParams& params, uint32_t dt_ms, PixelSpan pixels);
+    bool is_static;
+};
+
+constexpr EffectDescriptor EFFECTS[] = {
+    {EFFECT_MODE_OFF, nullptr, render_off, true},
+    {EFFECT_MODE_STATIC, nullptr, render_static, true},
+    {EFFECT_MODE_RAINBOW, nullptr, render_rainbow, false},
+    {EFFECT_MODE_BREATHING, nullptr, render_breathing, false},
+    {EFFECT_MODE_CHASE, nullptr, render_chase, false},
+    {EFFECT_MODE_MUSIC_VU, reset_music, render_music_vu, false},
+    {EFFECT_MODE_COLOR_CYCLE, nullptr, render_color_cycle, false},
+    {EFFECT_MODE_DIRECT, nullptr, nullptr, true},
+    {EFFECT_MODE_SPECTRUM_BARS, reset_spectrum, render_spectrum_bars, false},
+    {EFFECT_MODE_SPECTRUM, reset_spectrum, render_spectrum, false},
+    {EFFECT_MODE_ANIMATION, animation_start, render_animation, false},
+    {EFFECT_MODE_PROGRAM, nullptr, render_program, false},
+};
+
+constexpr bool effects_indexed_by_mode()
+{
+    for (uint i = 0; i < sizeof(EFFECTS) / sizeof(EFFECTS[0]); i++) {
+        if (EFFECTS[i].mode != i) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static_assert(effects_indexed_by_mode(), "EFFECTS must be ordered by EffectMode");
+
+// Unknown modes keep whatever is on the strip, as before.
+const EffectDescriptor* find_effect(uint8_t mode)
+{
+    return (mode < sizeof(EFFECTS) / sizeof(EFFECTS[0])) ? &EFFECTS[mode] : nullptr;
+}
+
+// A finished non-looping animation holds its last frame, so it counts as static.
+bool effect_is_static(const EffectDescriptor& effect)
+{
+    return effect.is_static || (effect.mode == EFFECT_MODE_ANIMATION && animation_finished());
+}
+
+// Overlay layers, composited in order over the base mode. Each one runs its own
+// effect instance over a segment of the strip. A zone is a layer that replaces the
+// pixels below it and may carry its own color, speed and pixel mapping.
+struct Layer {
+    uint8_t mode;
+    uint8_t blend;
+    uint8_t opacity;
+    uint8_t flags;
+    // The segment holds `repeat` identical units (e.g. daisy-chained fans); the
+    // effect renders one unit and every unit shows it, phase-aligned.
+    uint8_t repeat;
+    uint8_t rotation;
+    uint8_t speed;
+    Rgb color;
+    uint16_t start;
+    // 0 when the layer is unused.
+    uint16_t length;
+    // Offset of the unit's index map in layer_maps, or NO_MAP for in-order pixels.
+    uint16_t map_offset;
+    EffectState state;
+};
+
+constexpr uint16_t NO_MAP = 0xFFFF;
+
+Layer layers[MAX_LAYERS] = {};
+// Scratch pixels for the layer being composited, and the same pixels in strip order.
+Rgb layer_pixels[MAX_LEDS];
+Rgb mapped_pixels[MAX_LEDS];
+// Rendered pixel -> position within its unit, per mapped layer, rebuilt whenever a
+// layer changes so compositing only does a linear pass.
+uint16_t layer_maps[MAX_LEDS];
+
+bool layer_needs_map(const Layer& layer)
+{
+    return layer.repeat > 1 || layer.rotation != 0 || (layer.flags & ZONE_REVERSE) != 0;
+}
+
+uint16_t layer_unit(const Layer& layer)
+{
+    return static_cast<uint16_t>(layer.length / layer.repeat);
+}
+
+// Returns false when the maps do not fit; the layers are left unmapped then.
+bool rebuild_layer_maps()
+{
+    uint16_t used = 0;
+    for (Layer& layer : layers) {
+        layer.map_offset = NO_MAP;
+        if (layer.length == 0 || !layer_needs_map(layer)) {
+            continue;
+        }
+
+        const uint16_t unit = layer_unit(layer);
+        if (unit > MAX_LEDS - used) {
+            return false;
+        }
+        const bool reverse = (layer.flags & ZONE_REVERSE) != 0;
+        for (uint16_t i = 0; i < unit; i++) {
+            const uint16_t logical = reverse ? unit - 1u - i : i;
+            layer_maps[used + i] = static_cast<uint16_t>((logical + layer.rotation) % unit);
+        }
+        layer.map_offset = used;
+        used = static_cast<uint16_t>(used + unit);
+    }
+    return true;
+}
+
+EffectParams layer_params(const Layer& layer)
+{
+    const bool own_color = (layer.flags & ZONE_OWN_COLOR) != 0;
+    return {
+        own_color ? layer.color : base_color,
+        (layer.speed == ZONE_SPEED_GLOBAL) ? effect_speed : layer.speed,
+        own_color || host_color_received,
+    };
+}
+
+// Blends src over dst with an opacity of 0-255. One loop per mode keeps the
+// per-pixel path free of branches on the mode.
+void blend_pixels(Rgb* dst, const Rgb* src, uint16_t count, uint8_t blend, uint8_t opacity)
+{
+    const uint32_t weight = opacity + 1u;
+    switch (blend) {
+    case BLEND_ADD:
+        for (uint i = 0; i < count; i++) {
+            const uint32_t r = dst[i].r + ((src[i].r * weight) >> 8);
+            const uint32_t g = dst[i].g + ((src[i].g * weight) >> 8);
+            const uint32_t b = dst[i].b + ((src[i].b * weight) >> 8);
+            dst[i] = {static_cast<uint8_t>(r > 255 ? 255 : r), static_cast<uint8_t>(g > 255 ? 255 : g),
+                static_cast<uint8_t>(b > 255 ? 255 : b)};
+        }
+        break;
+    case BLEND_MULTIPLY:
+        for (uint i = 0; i < count; i++) {
+            // The factor fades towards 1.0 (no change) as the opacity drops.
+            const uint32_t r = 256u - (((255u - src[i].r) * weight) >> 8);
+            const uint32_t g = 256u - (((255u - src[i].g) * weight) >> 8);
+            const uint32_t b = 256u - (((255u - src[i].b) * weight) >> 8);
+            dst[i] = {static_cast<uint8_t>((dst[i].r * r) >> 8), static_cast<uint8_t>((dst[i].g * g) >> 8),
+                static_cast<uint8_t>((dst[i].b * b) >> 8)};
+        }
+        break;
+    case BLEND_MAX:
+        for (uint i = 0; i < count; i++) {
+            const uint8_t r = static_cast<uint8_t>((src[i].r * weight) >> 8);
+            const uint8_t g = static_cast<uint8_t>((src[i].g * weight) >> 8);
+            const uint8_t b = static_cast<uint8_t>((src[i].b * weight) >> 8);
+            dst[i] = {(r > dst[i].r) ? r : dst[i].r, (g > dst[i].g) ? g : dst[i].g, (b > dst[i].b) ? b : dst[i].b};
+        }
+        break;
+    case BLEND_ALPHA:
+    default:
+        for (uint i = 0; i < count; i++) {
+            dst[i] = lerp_color(dst[i], src[i], weight << 8);
+        }
+        break;
+    }
+}
+
+// Renders one unit of the layer, expands it over the segment and blends it in.
+void composite_layer(Layer& layer, uint32_t dt_ms, PixelSpan pixels)
+{
+    const uint16_t unit = layer_unit(layer);
+    if (unit == 0 || layer.start >= pixels.count) {
+        return;
+    }
+
+    const EffectParams params = layer_params(layer);
+    EFFECTS[layer.mode].render(layer.state, params, dt_ms, {layer_pixels, unit});
+
+    const uint16_t segment = static_cast<uint16_t>(unit * layer.repeat);
+    const uint16_t available = pixels.count - layer.start;
+    const uint16_t length = (segment < available) ? segment : available;
+    const Rgb* source = layer_pixels;
+    if (layer.map_offset != NO_MAP) {
+        const uint16_t* map = &layer_maps[layer.map_offset];
+        for (uint16_t base = 0; base < segment; base = static_cast<uint16_t>(base + unit)) {
+            Rgb* target = &mapped_pixels[base];
+            for (uint16_t i = 0; i < unit; i++) {
+                target[map[i]] = layer_pixels[i];
+            }
+        }
+        source = mapped_pixels;
     }
+    blend_pixels(&pixels.data[layer.start], source, length, layer.blend, layer.opacity);
+}
 
+// Advances the system animation; returns false once none is running. `changed`
+// reports whether its pixels differ from the previous frame.
+bool step_system_animation(uint32_t now_ms, uint16_t count, bool& changed)
+{
     const uint32_t elapsed = now_ms - animation_started_ms;
     if (system_animation == SystemAnimation::Startup) {
         const uint32_t step = elapsed / 70u;
-        if (step >= NUM_LEDS) {
+        if (step >= count) {
             cancel_system_animation();
-            led_clear();
-            return true;
-        }
-        if (step != last_animation_step) {
-            last_animation_step = step;
-            led_fill({0, 0, 0});
-            led_set_pixel(step, {50, 50, 150});
-            led_show();
+            return false;
         }
+        changed = (step != last_animation_step);
+        last_animation_step = step;
         return true;
     }
 
     if (system_animation == SystemAnimation::Connection) {
-        constexpr uint32_t duration_ms = 1200;
-        if (elapsed >= duration_ms) {
+        if (elapsed >= CONNECTION_ANIMATION_MS) {
             cancel_system_animation();
-            led_clear();
-            return true;
+            return false;
         }
-
-        const float phase = static_cast<float>(elapsed) / duration_ms;
-        const float pulses = sinf(phase * 4.0f * 3.14159265f);
-        const float intensity = pulses * pulses;
-        led_fill(scale_color({0, 0, 120}, intensity));
-        led_show();
+        changed = true;
         return true;
     }
 
     return false;
 }
 
+// The startup sweep replaces the strip; the connection pulse is added on top of it.
+void composite_system_animation(uint32_t now_ms, PixelSpan pixels)
+{
+    const PixelSpan overlay = {layer_pixels, pixels.count};
+    if (system_animation == SystemAnimation::Startup) {
+        fill_pixels(overlay, {0, 0, 0});
+        overlay.data[last_animation_step] = {50, 50, 150};
+        blend_pixels(pixels.data, overlay.data, pixels.count, BLEND_ALPHA, 255);
+        return;
+    }
+
+    // Two full sine periods over the animation, squared into four pulses.
+    constexpr uint32_t pulse_rate = static_cast<uint32_t>(2.0 * 4294967296.0 / CONNECTION_ANIMATION_MS + 0.5);
+    const int32_t pulses = sin_q15((now_ms - animation_started_ms) * pulse_rate);
+    const uint32_t intensity = static_cast<uint32_t>((pulses * pulses) >> 14);
+    fill_pixels(overlay, scale_color({0, 0, 120}, intensity));
+    blend_pixels(pixels.data, overlay.data, pixels.count, BLEND_ADD, 255);
+}
+
+// Renders the base mode, the layers and any system animation into the arena;
+// returns false when the frame would not change.
+bool render_frame(uint32_t now_ms, uint32_t dt_ms)
+{
+    const PixelSpan pixels = led_pixels();
+    const EffectDescriptor* base = find_effect(current_mode);
+    // Direct and unknown modes leave the arena to the host, so nothing is composited.
+    if (base == nullptr || base->render == nullptr) {
+        return false;
+    }
+
+    bool animation_changed = false;
+    const bool animation = (system_animation != SystemAnimation::None)
+        && step_system_animation(now_ms, pixels.count, animation_changed);
+    bool changed = static_frame_dirty || animation_changed || !effect_is_static(*base);
+    for (const Layer& layer : layers) {
+        if (layer.length != 0 && !effect_is_static(EFFECTS[layer.mode])) {
+            changed = true;
+        }
+    }
+    if (!changed) {
+        return false;
+    }
+    static_frame_dirty = false;
+
+    update_music_envelope(dt_ms);
+    update_spectrum_envelopes(dt_ms);
+
+    const EffectParams params = {base_color, effect_speed, host_color_received};
+    base->render(base_state, params, dt_ms, pixels);
+    for (Layer& layer : layers) {
+        if (layer.length != 0) {
+            composite_layer(layer, dt_ms, pixels);
+        }
+    }
+    if (animation) {
+        composite_system_animation(now_ms, pixels);
+    }
+    return true;
+}
+
+bool configure_layer(uint8_t index, const ZoneConfig& zone, uint8_t blend, uint8_t opacity)
+{
+    const EffectDescriptor* effect = find_effect(zone.mode);
+    // The animation player keeps a single frame, so it only runs as the base mode.
+    if (index >= MAX_LAYERS || zone.repeat == 0 || zone.length > MAX_LEDS
+        || (zone.length != 0
+            && (effect == nullptr || effect->render == nullptr || zone.mode == EFFECT_MODE_ANIMATION))) {
+        return false;
+    }
+
+    Layer& layer = layers[index];
+    const Layer previous = layer;
+    if (layer.mode != zone.mode || layer.length == 0) {
+        layer.state = {};
+    }
+    layer.mode = zone.mode;
+    layer.blend = blend;
+    layer.opacity = opacity;
+    layer.flags = zone.flags;
+    layer.repeat = zone.repeat;
+    layer.rotation = zone.rotation;
+    layer.speed = (zone.speed > 100 && zone.speed != ZONE_SPEED_GLOBAL) ? 100 : zone.speed;
+    layer.color = zone.color;
+    layer.start = zone.start;
+    layer.length = zone.length;
+    if (!rebuild_layer_maps()) {
+        layer = previous;
+        rebuild_layer_maps();
+        return false;
+    }
+    static_frame_dirty = true;
+    return true;
+}
+
 } // namespace
 
 void effects_init()
 {
     led_set_brightness(DEFAULT_BRIGHTNESS);
     current_mode = EFFECT_MODE_MUSIC_VU;
-    music_level = 0;
-    music_envelope = 0.0f;
+    reset_music();
     music_style = MUSIC_STYLE_INTENSITY_WHEEL;
     effect_speed = DEFAULT_EFFECT_SPEED;
+    frame_rate = DEFAULT_FRAME_RATE;
     base_color = SAFE_DEFAULT_BASE_COLOR;
     host_color_received = false;
     last_frame_ms = 0;
-    led_clear();
+    static_frame_dirty = true;
+    base_state = {};
+    for (Layer& layer : layers) {
+        layer.length = 0;
+        layer.map_offset = NO_MAP;
+    }
+    for (uint i = 0; i < 256; i++) {
+        meter_gradient[i] = audio_meter_color(i << 8);
+    }
 }
 
 void effects_request_startup()
@@ -331,24 +712,18 @@ void effects_set_color(uint8_t r, uint8_t g, uint8_t b)
     cancel_system_animation();
     base_color = {r, g, b};
     host_color_received = true;
-
-    if (current_mode == EFFECT_MODE_STATIC) {
-        render_static();
-    }
 }
 
 void effects_set_mode(uint8_t mode)
 {
     cancel_system_animation();
+    if (mode != current_mode) {
+        base_state = {};
+    }
     current_mode = mode;
-    if (current_mode == EFFECT_MODE_OFF) {
-        led_clear();
-    } else if (current_mode == EFFECT_MODE_STATIC) {
-        render_static();
-    } else if (current_mode == EFFECT_MODE_MUSIC_VU) {
-        music_level = 0;
-        music_envelope = 0.0f;
-        led_clear();
+    const EffectDescriptor* effect = find_effect(mode);
+    if (effect != nullptr && effect->init != nullptr) {
+        effect->init();
     }
 }
 
@@ -356,9 +731,25 @@ void effects_off()
 {
     cancel_system_animation();
     current_mode = EFFECT_MODE_OFF;
-    music_level = 0;
-    music_envelope = 0.0f;
-    led_clear();
+    reset_music();
+    for (Layer& layer : layers) {
+        layer.length = 0;
+        layer.map_offset = NO_MAP;
+    }
+}
+
+bool effects_set_layer(uint8_t index, uint8_t mode, uint8_t blend, uint8_t opacity, uint16_t start, uint16_t length)
+{
+    if (blend > BLEND_ALPHA) {
+        return false;
+    }
+    const ZoneConfig plain = {mode, 0, 1, 0, ZONE_SPEED_GLOBAL, {0, 0, 0}, start, length};
+    return configure_layer(index, plain, blend, opacity);
+}
+
+bool effects_set_zone(uint8_t index, const ZoneConfig& zone)
+{
+    return configure_layer(index, zone, BLEND_ALPHA, 255);
 }
 
 void effects_set_music_level(uint8_t level)
@@ -367,6 +758,25 @@ void effects_set_music_level(uint8_t level)
     music_level = level;
 }
 
+void effects_set_spectrum(const uint8_t* levels, uint8_t count)
+{
+    cancel_system_animation();
+    if (count > MAX_SPECTRUM_BANDS) {
+        count = MAX_SPECTRUM_BANDS;
+    }
+    // The strip layout follows the band count of the latest update.
+    for (uint band = 0; band < count; band++) {
+        spectrum_levels[band] = levels[band];
+    }
+    spectrum_bands = count;
+}
+
+void effects_set_led_count(uint16_t count)
+{
+    led_set_count(count);
+    static_frame_dirty = true;
+}
+
 void effects_set_speed(uint8_t speed)
 {
     effect_speed = (speed > 100) ? 100 : speed;
@@ -379,52 +789,94 @@ void effects_set_music_style(uint8_t style)
         : MUSIC_STYLE_INTENSITY_WHEEL;
 }
 
+void effects_direct_write(uint16_t offset, const uint8_t* rgb, uint16_t count)
+{
+    if (current_mode != EFFECT_MODE_DIRECT) {
+        cancel_system_animation();
+        current_mode = EFFECT_MODE_DIRECT;
+    }
+    led_write_rgb(offset, rgb, count);
+}
+
+void effects_direct_commit()
+{
+    if (current_mode == EFFECT_MODE_DIRECT) {
+        led_show();
+    }
+}
+
+bool effects_set_frame_rate(uint16_t fps)
+{
+    for (uint16_t rate : FRAME_RATES) {
+        if (rate == fps) {
+            frame_rate = fps;
+            return true;
+        }
+    }
+    return false;
+}
+
 uint8_t effects_get_mode()
 {
     return current_mode;
 }
 
+bool effects_idle()
+{
+    const EffectDescriptor* base = find_effect(current_mode);
+    // A dithered frame needs a new rounding every frame, like an animated effect.
+    if (static_frame_dirty || system_animation != SystemAnimation::None || current_mode == EFFECT_MODE_DIRECT
+        || (base != nullptr && !effect_is_static(*base)) || led_power_settling() || led_output_dirty()
+        || led_get_dither()) {
+        return false;
+    }
+    for (const Layer& layer : layers) {
+        if (layer.length != 0 && !effect_is_static(EFFECTS[layer.mode])) {
+            return false;
+        }
+    }
+    return true;
+}
+
 uint8_t effects_get_music_level()
 {
     return music_level;
 }
 
-void effects_update(uint32_t now_ms)
+uint8_t effects_get_music_style()
 {
-    if (last_frame_ms != 0 && (now_ms - last_frame_ms) < EFFECT_FRAME_MS) {
-        return;
-    }
+    return music_style;
+}
 
-    const float dt_ms = (last_frame_ms == 0) ? EFFECT_FRAME_MS : static_cast<float>(now_ms - last_frame_ms);
-    last_frame_ms = now_ms;
+uint16_t effects_get_frame_rate()
+{
+    return frame_rate;
+}
 
-    if (render_system_animation(now_ms)) {
-        return;
-    }
+bool effects_get_color(Rgb& color)
+{
+    color = base_color;
+    return host_color_received;
+}
 
-    switch (current_mode) {
-    case EFFECT_MODE_RAINBOW:
-        render_rainbow(dt_ms);
-        break;
-    case EFFECT_MODE_BREATHING:
-        render_breathing(dt_ms);
-        break;
-    case EFFECT_MODE_CHASE:
-        render_chase(dt_ms);
-        break;
-    case EFFECT_MODE_MUSIC_VU:
-        render_music_vu(dt_ms);
-        break;
-    case EFFECT_MODE_COLOR_CYCLE:
-        render_color_cycle(dt_ms);
-        break;
-    case EFFECT_MODE_STATIC:
-    case EFFECT_MODE_OFF:
-    default:
-        break;
+bool effects_update(uint32_t now_ms)
+{
+    // Wait for the previous frame to latch rather than overwrite it mid-transfer.
+    if (led_frame_in_flight()) {
+        return false;
     }
 
-    (void)host_color_received;
+    const uint32_t started_us = time_us_32();
+    const uint32_t dt_ms = (last_frame_ms == 0) ? 1000u / frame_rate : now_ms - last_frame_ms;
+    last_frame_ms = now_ms;
+
+    const bool rendered = render_frame(now_ms, dt_ms);
+    telemetry_record(TELEMETRY_RENDER, started_us);
+    // Temporal dither changes the rounding every frame, so even a static frame is re-sent.
+    if (rendered || led_get_dither() || led_output_dirty() || led_keepalive_due() || led_power_settling()) {
+        led_show();
+    }
+    return true;
 }
 
 } // namespace firmware
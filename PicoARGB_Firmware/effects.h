@@ -14,6 +14,50 @@ enum EffectMode : uint8_t {
     EFFECT_MODE_CHASE = 4,
     EFFECT_MODE_MUSIC_VU = 5,
     EFFECT_MODE_COLOR_CYCLE = 6,
+    // Pixels are streamed by the host; the firmware only latches them.
+    EFFECT_MODE_DIRECT = 7,
+    // Driven by SPECTRUM: one bar per band, or bands interpolated along the strip.
+    EFFECT_MODE_SPECTRUM_BARS = 8,
+    EFFECT_MODE_SPECTRUM = 9,
+    // Plays the uploaded keyframe animation (see animation.h).
+    EFFECT_MODE_ANIMATION = 10,
+    // Runs the uploaded per-pixel program (see pixel_program.h).
+    EFFECT_MODE_PROGRAM = 11,
+};
+
+constexpr uint8_t MAX_SPECTRUM_BANDS = 32;
+
+// How an overlay layer combines with the pixels below it.
+enum BlendMode : uint8_t {
+    BLEND_ADD = 0,
+    BLEND_MULTIPLY = 1,
+    BLEND_MAX = 2,
+    BLEND_ALPHA = 3,
+};
+
+constexpr uint8_t MAX_LAYERS = 4;
+
+// Zones are layers that replace the pixels below them, with their own parameters.
+enum ZoneFlags : uint8_t {
+    ZONE_REVERSE = 0x01,
+    // Use ZoneConfig::color instead of the global color.
+    ZONE_OWN_COLOR = 0x02,
+};
+
+// Zone speed that follows the global effect speed.
+constexpr uint8_t ZONE_SPEED_GLOBAL = 0xFF;
+
+struct ZoneConfig {
+    uint8_t mode;
+    uint8_t flags;
+    // Identical units in the segment (e.g. fans in a chain), all showing one render.
+    uint8_t repeat;
+    // Offset of each unit's first LED, e.g. where a fan ring starts.
+    uint8_t rotation;
+    uint8_t speed;
+    Rgb color;
+    uint16_t start;
+    uint16_t length;
 };
 
 enum MusicStyle : uint8_t {
@@ -24,7 +68,9 @@ enum MusicStyle : uint8_t {
 extern uint8_t effect_speed;
 
 void effects_init();
-void effects_update(uint32_t now_ms);
+// Renders and shows the frame for now_ms; the frame scheduler decides when.
+// Returns false, without rendering, while the previous frame is still being sent.
+bool effects_update(uint32_t now_ms);
 void effects_request_startup();
 void effects_request_connection();
 
@@ -32,10 +78,30 @@ void effects_set_color(uint8_t r, uint8_t g, uint8_t b);
 void effects_set_mode(uint8_t mode);
 void effects_off();
 void effects_set_music_level(uint8_t level);
+void effects_set_spectrum(const uint8_t* levels, uint8_t count);
+// Runs `mode` over [start, start + length) on top of the base mode; length 0
+// removes the layer. Returns false for an unknown layer, mode or blend.
+bool effects_set_layer(uint8_t index, uint8_t mode, uint8_t blend, uint8_t opacity, uint16_t start, uint16_t length);
+// Configures layer `index` as a zone. Returns false when the zone is invalid or its
+// pixel map does not fit.
+bool effects_set_zone(uint8_t index, const ZoneConfig& zone);
+void effects_set_led_count(uint16_t count);
 void effects_set_speed(uint8_t speed);
 void effects_set_music_style(uint8_t style);
+// Returns false for a rate not listed in FRAME_RATES.
+bool effects_set_frame_rate(uint16_t fps);
+void effects_direct_write(uint16_t offset, const uint8_t* rgb, uint16_t count);
+void effects_direct_commit();
 
 uint8_t effects_get_mode();
+// True while every frame would repeat the last one: a static mode with only static
+// layers, nothing left to redraw, no system animation and no temporal dither.
+// Direct mode is never idle since the host paces it.
+bool effects_idle();
 uint8_t effects_get_music_level();
+uint8_t effects_get_music_style();
+uint16_t effects_get_frame_rate();
+// Returns false while no color has been set by the host.
+bool effects_get_color(Rgb& color);
 
 } // namespace firmware
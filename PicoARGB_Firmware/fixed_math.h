@@ -0,0 +1,223 @@
+#pragma once
+
+#include <stdint.h>
+#include "led_driver.h"
+
+// Integer helpers for the effect renderers. The M0+ has no FPU, so phases are kept
+// as Q32 fractions of a turn, intensities as Q16 (65536 = 1.0) and tables are
+// generated at compile time.
+namespace firmware {
+
+constexpr uint32_t Q16_ONE = 65536;
+
+namespace detail {
+
+constexpr double PI = 3.14159265358979323846;
+
+constexpr double const_sin(double x)
+{
+    while (x > PI) {
+        x -= 2.0 * PI;
+    }
+    while (x < -PI) {
+        x += 2.0 * PI;
+    }
+
+    double term = x;
+    double sum = x;
+    for (int n = 1; n < 16; n++) {
+        term *= -x * x / ((2.0 * n) * (2.0 * n + 1.0));
+        sum += term;
+    }
+    return sum;
+}
+
+constexpr double const_log(double x)
+{
+    // ln(x) = ln(m) + k*ln(2) with m in [0.5, 1), then the atanh series on m.
+    constexpr double LN2 = 0.69314718055994530942;
+    int k = 0;
+    while (x < 0.5) {
+        x *= 2.0;
+        k--;
+    }
+    while (x >= 1.0) {
+        x *= 0.5;
+        k++;
+    }
+
+    const double z = (x - 1.0) / (x + 1.0);
+    double term = z;
+    double sum = 0.0;
+    for (int n = 1; n < 40; n += 2) {
+        sum += term / n;
+        term *= z * z;
+    }
+    return 2.0 * sum + k * LN2;
+}
+
+constexpr double const_exp(double x)
+{
+    double term = 1.0;
+    double sum = 1.0;
+    for (int n = 1; n < 40; n++) {
+        term *= x / n;
+        sum += term;
+    }
+    return sum;
+}
+
+constexpr double const_pow(double base, double exponent)
+{
+    return (base <= 0.0) ? 0.0 : const_exp(exponent * const_log(base));
+}
+
+struct SineTable {
+    int16_t values[257];
+};
+
+constexpr SineTable make_sine_table()
+{
+    SineTable table{};
+    for (int i = 0; i <= 256; i++) {
+        const double value = const_sin(2.0 * PI * i / 256.0) * 32767.0;
+        table.values[i] = static_cast<int16_t>(value < 0.0 ? value - 0.5 : value + 0.5);
+    }
+    return table;
+}
+
+// Fractional powers are steepest near zero, so the first of the 256 steps is split
+// again into 16 finer ones to stay within an 8-bit LSB of the exact curve.
+struct CurveTable {
+    uint16_t values[257];
+    uint16_t low[17];
+};
+
+constexpr uint16_t power_q16(double x, double exponent)
+{
+    const double value = const_pow(x, exponent) * 65536.0 + 0.5;
+    return static_cast<uint16_t>(value > 65535.0 ? 65535.0 : value);
+}
+
+// values[i] = (i / 256)^exponent and low[i] = (i / 4096)^exponent in Q16, saturated
+// to 0xFFFF.
+constexpr CurveTable make_power_table(double exponent)
+{
+    CurveTable table{};
+    for (int i = 0; i <= 256; i++) {
+        table.values[i] = power_q16(i / 256.0, exponent);
+    }
+    for (int i = 0; i <= 16; i++) {
+        table.low[i] = power_q16(i / 4096.0, exponent);
+    }
+    return table;
+}
+
+constexpr SineTable SINE_TABLE = make_sine_table();
+
+} // namespace detail
+
+// Converts a rate given in degrees (or radians) per millisecond to Q32 turns per millisecond.
+constexpr uint32_t turns_per_ms_from_degrees(double degrees_per_ms)
+{
+    return static_cast<uint32_t>(degrees_per_ms / 360.0 * 4294967296.0 + 0.5);
+}
+
+constexpr uint32_t turns_per_ms_from_radians(double radians_per_ms)
+{
+    return static_cast<uint32_t>(radians_per_ms / (2.0 * detail::PI) * 4294967296.0 + 0.5);
+}
+
+constexpr uint32_t to_q16(double value)
+{
+    return static_cast<uint32_t>(value * 65536.0 + 0.5);
+}
+
+// sin() of a Q32 turn, as Q15 (-32767..32767), linearly interpolated from 256 steps.
+inline int32_t sin_q15(uint32_t phase)
+{
+    const uint32_t index = phase >> 24;
+    const int32_t frac = static_cast<int32_t>((phase >> 8) & 0xFFFFu);
+    const int32_t a = detail::SINE_TABLE.values[index];
+    const int32_t b = detail::SINE_TABLE.values[index + 1];
+    return a + (((b - a) * frac) >> 16);
+}
+
+// Looks up a Q16 input (0..65536) in a curve table with linear interpolation.
+inline uint32_t curve_q16(const detail::CurveTable& table, uint32_t x)
+{
+    if (x >= Q16_ONE) {
+        return table.values[256];
+    }
+    if (x < 256u) {
+        const uint32_t a = table.low[x >> 4];
+        const uint32_t b = table.low[(x >> 4) + 1];
+        return a + (((b - a) * (x & 0xFu)) >> 4);
+    }
+    const uint32_t index = x >> 8;
+    const uint32_t frac = x & 0xFFu;
+    const uint32_t a = table.values[index];
+    const uint32_t b = table.values[index + 1];
+    return a + (((b - a) * frac) >> 8);
+}
+
+inline uint32_t mul_q16(uint32_t a, uint32_t b)
+{
+    return static_cast<uint32_t>((static_cast<uint64_t>(a) * b) >> 16);
+}
+
+inline uint8_t scale_u8(uint8_t value, uint32_t intensity)
+{
+    return static_cast<uint8_t>((value * intensity) >> 16);
+}
+
+inline Rgb scale_color(Rgb color, uint32_t intensity)
+{
+    const uint32_t safe = (intensity > Q16_ONE) ? Q16_ONE : intensity;
+    return {scale_u8(color.r, safe), scale_u8(color.g, safe), scale_u8(color.b, safe)};
+}
+
+inline uint8_t lerp_u8(uint8_t a, uint8_t b, uint32_t t)
+{
+    const int32_t delta = static_cast<int32_t>(b) - static_cast<int32_t>(a);
+    return static_cast<uint8_t>(((static_cast<int32_t>(a) << 16) + delta * static_cast<int32_t>(t)) >> 16);
+}
+
+inline Rgb lerp_color(Rgb a, Rgb b, uint32_t t)
+{
+    const uint32_t safe = (t > Q16_ONE) ? Q16_ONE : t;
+    return {lerp_u8(a.r, b.r, safe), lerp_u8(a.g, b.g, safe), lerp_u8(a.b, b.b, safe)};
+}
+
+// HSV to RGB with a 16-bit hue (65536 = 360 degrees) and 8-bit saturation/value.
+inline Rgb hsv_to_rgb(uint16_t hue, uint8_t saturation, uint8_t value)
+{
+    const uint32_t scaled = static_cast<uint32_t>(hue) * 6u;
+    const uint32_t sector = scaled >> 16;
+    const uint32_t frac = scaled & 0xFFFFu;
+
+    const uint32_t chroma = (static_cast<uint32_t>(value) * saturation * 257u) >> 8;
+    const uint32_t rising = (chroma * frac) >> 16;
+    const uint32_t falling = (chroma * (Q16_ONE - frac)) >> 16;
+    const uint32_t m = (static_cast<uint32_t>(value) << 8) - chroma;
+
+    uint32_t r = 0;
+    uint32_t g = 0;
+    uint32_t b = 0;
+    switch (sector) {
+    case 0: r = chroma; g = rising; break;
+    case 1: r = falling; g = chroma; break;
+    case 2: g = chroma; b = rising; break;
+    case 3: g = falling; b = chroma; break;
+    case 4: r = rising; b = chroma; break;
+    default: r = chroma; b = falling; break;
+    }
+
+    return {
+        static_cast<uint8_t>((r + m) >> 8),
+        static_cast<uint8_t>((g + m) >> 8),
+        static_cast<uint8_t>((b + m) >> 8),
+    };
+}
+
+} // namespace firmware
@@ -0,0 +1,176 @@
+#include "frame_scheduler.h"
+
+#include "config.h"
+#include "effects.h"
+#include "hardware/clocks.h"
+#include "hardware/pll.h"
+#include "hardware/sync.h"
+#include "hardware/timer.h"
+#include "led_driver.h"
+#include "led_output.h"
+#include "telemetry.h"
+
+namespace firmware {
+namespace {
+
+uint frame_alarm = 0;
+uint32_t period_us = 0;
+uint16_t active_rate = 0;
+uint64_t next_deadline_us = 0;
+// Written by the alarm, read by the render loop; both run on the render core.
+// Only 32-bit values are shared, so each read is atomic.
+volatile uint32_t deadlines = 0;
+volatile uint32_t last_deadline_us = 0;
+volatile uint32_t last_deadline_ms = 0;
+uint32_t handled = 0;
+uint32_t frame_started_us = 0;
+// Idle: the deadlines slow down to IDLE_WAKE_MS, and once the last frame has been
+// sent clk_sys can drop to the USB PLL.
+bool idle = false;
+bool clock_lowered = false;
+uint32_t run_clock_khz = 0;
+
+void record_deadline()
+{
+    last_deadline_us = static_cast<uint32_t>(next_deadline_us);
+    last_deadline_ms = static_cast<uint32_t>(next_deadline_us / 1000u);
+    deadlines = deadlines + 1;
+}
+
+// A target that has already passed is counted as due instead of waiting for it,
+// so a long stall shows up as skipped frames rather than a burst of renders.
+void arm_next_deadline()
+{
+    while (true) {
+        next_deadline_us += period_us;
+        if (!hardware_alarm_set_target(frame_alarm, from_us_since_boot(next_deadline_us))) {
+            return;
+        }
+        record_deadline();
+    }
+}
+
+void deadline_reached(uint alarm_num)
+{
+    (void)alarm_num;
+    record_deadline();
+    arm_next_deadline();
+    __sev();
+}
+
+// Restarts the deadlines with a new period, the first one either now or one
+// period from now.
+void start_period(uint32_t us, bool due_now)
+{
+    const uint32_t irq_state = save_and_disable_interrupts();
+    hardware_alarm_cancel(frame_alarm);
+    period_us = us;
+    next_deadline_us = time_us_64();
+    if (due_now) {
+        record_deadline();
+    }
+    arm_next_deadline();
+    restore_interrupts(irq_state);
+}
+
+void start_rate(uint16_t fps, bool due_now)
+{
+    active_rate = fps;
+    start_period(1000000u / fps, due_now);
+}
+
+// The output timing follows clk_sys, so the clock only changes between frames.
+void lower_clock()
+{
+#if ENABLE_IDLE_UNDERCLOCK
+    clock_configure(clk_sys, CLOCKS_CLK_SYS_CTRL_SRC_VALUE_CLKSRC_CLK_SYS_AUX,
+        CLOCKS_CLK_SYS_CTRL_AUXSRC_VALUE_CLKSRC_PLL_USB, USB_CLK_KHZ * KHZ, USB_CLK_KHZ * KHZ);
+    pll_deinit(pll_sys);
+    led_output_clock_changed();
+    clock_lowered = true;
+#endif
+}
+
+void restore_clock()
+{
+#if ENABLE_IDLE_UNDERCLOCK
+    set_sys_clock_khz(run_clock_khz, true);
+    led_output_clock_changed();
+    clock_lowered = false;
+#endif
+}
+
+// Returns false while the clock cannot be restored yet because a keep-alive frame
+// is still being sent at the idle clock.
+bool leave_idle()
+{
+    if (clock_lowered) {
+        if (led_frame_in_flight()) {
+            return false;
+        }
+        restore_clock();
+    }
+    idle = false;
+    start_rate(effects_get_frame_rate(), true);
+    return true;
+}
+
+} // namespace
+
+void frame_scheduler_init()
+{
+    frame_alarm = static_cast<uint>(hardware_alarm_claim_unused(true));
+    hardware_alarm_set_callback(frame_alarm, deadline_reached);
+    run_clock_khz = clock_get_hz(clk_sys) / KHZ;
+    handled = deadlines;
+    start_rate(effects_get_frame_rate(), false);
+}
+
+bool frame_scheduler_frame_due(uint32_t& frame_ms)
+{
+    // A host command may have given the frame something to animate.
+    if (idle && !effects_idle() && !leave_idle()) {
+        return false;
+    }
+    if (deadlines == handled) {
+        return false;
+    }
+    frame_ms = last_deadline_ms;
+    frame_started_us = time_us_32();
+    return true;
+}
+
+void frame_scheduler_frame_done()
+{
+    const uint32_t due = deadlines;
+    const uint32_t pending = due - handled;
+    handled = due;
+    if (idle) {
+        // Idle wake-ups are not frames.
+        return;
+    }
+    if (pending > 1) {
+        telemetry_count_frames_skipped(pending - 1);
+    }
+    // Late means the frame started over a quarter period after its deadline.
+    telemetry_count_frame(frame_started_us - last_deadline_us > period_us / 4u);
+
+    if (effects_idle()) {
+        idle = true;
+        start_period(IDLE_WAKE_MS * 1000u, false);
+    } else if (effects_get_frame_rate() != active_rate) {
+        start_rate(effects_get_frame_rate(), false);
+    }
+}
+
+void frame_scheduler_sleep()
+{
+    if (idle && !clock_lowered && !led_frame_in_flight()) {
+        lower_clock();
+    }
+    // The frame alarm, the LED latch and the command queue all raise an event; one
+    // raised before this point is latched, so nothing is missed.
+    __wfe();
+}
+
+} // namespace firmware
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stdint.h>
+
+namespace firmware {
+
+// Paces frames on the render core from a hardware alarm. Deadlines are kept in
+// microseconds and advance by exactly one period, so frame times neither jitter
+// with the main loop nor drift. Render core only.
+void frame_scheduler_init();
+
+// True while a frame deadline is pending; `frame_ms` is the time of the newest
+// one, which is the time the frame should show. Marks the frame as started.
+bool frame_scheduler_frame_due(uint32_t& frame_ms);
+// Accounts for the pending deadlines once their frame has been rendered: deadlines
+// passed without a frame count as skipped, a frame started well after its deadline
+// as late. Also follows changes of the configured frame rate.
+void frame_scheduler_frame_done();
+
+// Sleeps until the next deadline, interrupt or host command. While effects_idle()
+// holds, deadlines slow to IDLE_WAKE_MS and clk_sys is lowered once the output is
+// quiet; the first frame that can change restores both before it renders.
+void frame_scheduler_sleep();
+
+} // namespace firmware
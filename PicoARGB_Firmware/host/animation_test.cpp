@@ -0,0 +1,153 @@
+#include <utility>
+#include <vector>
+
+#include "animation.h"
+#include "check.h"
+#include "config.h"
+#include "effects.h"
+#include "mock_led_output.h"
+#include "protocol.h"
+#include "scenario.h"
+
+// Animation playback: a finished one-shot animation holds its last frame as a static
+// frame, while a looping one keeps playing. Uploads with malformed frames are
+// rejected when they end.
+namespace {
+
+using host::advance_frame;
+using host::mock_led_output_frame_count;
+
+constexpr uint16_t LED_COUNT = 60;
+constexpr uint32_t FRAME_US = 1000000u / firmware::DEFAULT_FRAME_RATE;
+constexpr uint16_t FRAME_MS = FRAME_US / 1000u;
+constexpr uint32_t WHITE_GRB = 0xFFFFFF00u;
+// Pixels of the hand-built images below.
+constexpr uint16_t SMALL_COUNT = 4;
+
+using Frame = std::pair<firmware::AnimationFrameType, std::vector<uint8_t>>;
+
+void play(uint8_t flags, uint32_t frames)
+{
+    host::reset_firmware(LED_COUNT);
+    host::upload_animation(host::build_animation(LED_COUNT, FRAME_MS, flags));
+    for (uint32_t i = 0; i < frames; i++) {
+        advance_frame(FRAME_US);
+    }
+}
+
+uint32_t frames_sent_over(uint32_t frames)
+{
+    const uint32_t before = mock_led_output_frame_count();
+    for (uint32_t i = 0; i < frames; i++) {
+        advance_frame(FRAME_US);
+    }
+    return mock_led_output_frame_count() - before;
+}
+
+void test_one_shot_holds_last_frame()
+{
+    // Frame periods are rounded down to whole ms, so the animation runs slightly
+    // faster than the render rate; twice its length is well past the end.
+    play(0, host::ANIMATION_FRAMES * 2u);
+    CHECK_EQ(firmware::effects_get_mode(), firmware::EFFECT_MODE_ANIMATION);
+    CHECK(firmware::effects_idle());
+    CHECK_EQ(frames_sent_over(30), 0);
+
+    // The dot of the last delta frame stays lit.
+    const host::RecordedFrame frame = host::mock_led_output_last_frame();
+    CHECK_EQ(frame.words[host::ANIMATION_FRAMES - 1], WHITE_GRB);
+    CHECK(frame.words[0] != WHITE_GRB);
+}
+
+void test_looping_animation_keeps_playing()
+{
+    play(firmware::ANIMATION_LOOP, host::ANIMATION_FRAMES * 2u);
+    CHECK(!firmware::effects_idle());
+    CHECK(frames_sent_over(30) >= 25);
+}
+
+std::vector<uint8_t> image_of(const std::vector<Frame>& frames)
+{
+    const firmware::AnimationHeader header = {{firmware::ANIMATION_MAGIC[0], firmware::ANIMATION_MAGIC[1]},
+        firmware::ANIMATION_VERSION, firmware::ANIMATION_LOOP, FRAME_MS, SMALL_COUNT,
+        static_cast<uint16_t>(frames.size()), 0};
+    std::vector<uint8_t> image(reinterpret_cast<const uint8_t*>(&header),
+        reinterpret_cast<const uint8_t*>(&header) + sizeof(header));
+    for (const Frame& frame : frames) {
+        image.push_back(frame.first);
+        image.push_back(static_cast<uint8_t>(frame.second.size()));
+        image.push_back(static_cast<uint8_t>(frame.second.size() >> 8));
+        image.insert(image.end(), frame.second.begin(), frame.second.end());
+    }
+    return image;
+}
+
+// Uploads over HID with a correct CRC; true when the animation started playing.
+bool plays(const std::vector<uint8_t>& image)
+{
+    host::reset_firmware(LED_COUNT);
+    host::set_mode(firmware::EFFECT_MODE_STATIC);
+    host::upload_animation(image);
+    return firmware::effects_get_mode() == firmware::EFFECT_MODE_ANIMATION;
+}
+
+// A red keyframe covering all four pixels.
+const Frame KEYFRAME = {firmware::ANIMATION_FRAME_RLE, {SMALL_COUNT, 255, 0, 0}};
+
+void test_well_formed_frames_play()
+{
+    CHECK(plays(image_of({KEYFRAME})));
+    CHECK(plays(image_of({{firmware::ANIMATION_FRAME_RAW, std::vector<uint8_t>(SMALL_COUNT * 3u, 7)}})));
+    CHECK(plays(image_of({{firmware::ANIMATION_FRAME_RLE, {1, 1, 2, 3, 3, 4, 5, 6}}})));
+    // A delta may end exactly at the last pixel, and an empty one holds the frame.
+    CHECK(plays(image_of({KEYFRAME, {firmware::ANIMATION_FRAME_DELTA, {2, 2, 0, 0, 255, 0, 0, 255}},
+        {firmware::ANIMATION_FRAME_DELTA, {}}})));
+}
+
+void test_bad_rle_is_rejected()
+{
+    // Runs must cover exactly the pixel count.
+    CHECK(!plays(image_of({{firmware::ANIMATION_FRAME_RLE, {SMALL_COUNT - 1, 255, 0, 0}}})));
+    CHECK(!plays(image_of({{firmware::ANIMATION_FRAME_RLE, {SMALL_COUNT + 1, 255, 0, 0}}})));
+    // Zero-length runs and a run cut short are malformed.
+    CHECK(!plays(image_of({{firmware::ANIMATION_FRAME_RLE, {0, 9, 9, 9, SMALL_COUNT, 255, 0, 0}}})));
+    CHECK(!plays(image_of({{firmware::ANIMATION_FRAME_RLE, {SMALL_COUNT, 255, 0, 0, 1, 255}}})));
+}
+
+void test_bad_delta_is_rejected()
+{
+    // Writing past the last pixel.
+    CHECK(!plays(image_of({KEYFRAME, {firmware::ANIMATION_FRAME_DELTA, {3, 2, 1, 1, 1, 2, 2, 2}}})));
+    CHECK(!plays(image_of({KEYFRAME, {firmware::ANIMATION_FRAME_DELTA, {SMALL_COUNT + 1, 0}}})));
+    // Fewer colors than the run's count.
+    CHECK(!plays(image_of({KEYFRAME, {firmware::ANIMATION_FRAME_DELTA, {0, 2, 1, 1, 1}}})));
+    // A delta has nothing to apply to as the first frame.
+    CHECK(!plays(image_of({{firmware::ANIMATION_FRAME_DELTA, {0, 1, 1, 1, 1}}})));
+}
+
+void test_bad_image_is_rejected()
+{
+    CHECK(!plays(image_of({{firmware::ANIMATION_FRAME_RAW, std::vector<uint8_t>(SMALL_COUNT * 3u - 1u, 7)}})));
+    CHECK(!plays(image_of({{static_cast<firmware::AnimationFrameType>(3), {SMALL_COUNT, 255, 0, 0}}})));
+    // Trailing bytes after the last frame.
+    std::vector<uint8_t> image = image_of({KEYFRAME});
+    image.push_back(0);
+    CHECK(!plays(image));
+    // A frame size running past the end of the image.
+    image = image_of({KEYFRAME});
+    image[sizeof(firmware::AnimationHeader) + 1]++;
+    CHECK(!plays(image));
+}
+
+} // namespace
+
+int main()
+{
+    RUN_TEST(test_one_shot_holds_last_frame);
+    RUN_TEST(test_looping_animation_keeps_playing);
+    RUN_TEST(test_well_formed_frames_play);
+    RUN_TEST(test_bad_rle_is_rejected);
+    RUN_TEST(test_bad_delta_is_rejected);
+    RUN_TEST(test_bad_image_is_rejected);
+    return host::checks_passed() ? 0 : 1;
+}
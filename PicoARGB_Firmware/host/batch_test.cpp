@@ -0,0 +1,129 @@
+#include <string.h>
+#include <initializer_list>
+
+#include "check.h"
+#include "command_queue.h"
+#include "config.h"
+#include "effects.h"
+#include "led_driver.h"
+#include "mock_led_output.h"
+#include "pixel_format.h"
+#include "protocol.h"
+#include "scenario.h"
+
+// BATCH reports: every entry is applied within one frame, entries that cannot be
+// batched are skipped, and parsing stops at a terminator or a truncated entry.
+namespace {
+
+using host::advance_frame;
+using host::mock_led_output_frame_count;
+
+constexpr uint16_t LED_COUNT = 60;
+constexpr uint32_t FRAME_US = 1000000u / firmware::DEFAULT_FRAME_RATE;
+
+// Queues one report as the USB core would and lets the render core process it.
+void send(uint8_t command, std::initializer_list<uint8_t> payload)
+{
+    firmware::HostCommand* slot = firmware::command_queue_reserve();
+    CHECK(slot != nullptr);
+    if (slot == nullptr) {
+        return;
+    }
+    slot->command = command;
+    slot->payload_size = static_cast<uint8_t>(payload.size());
+    memcpy(slot->payload, payload.begin(), payload.size());
+    firmware::command_queue_commit();
+    firmware::protocol_process_commands();
+}
+
+void start_static()
+{
+    host::reset_firmware(LED_COUNT);
+    host::set_mode(firmware::EFFECT_MODE_STATIC);
+    advance_frame(FRAME_US);
+}
+
+void test_batch_applies_every_entry()
+{
+    start_static();
+    send(firmware::CMD_BATCH, {
+        firmware::CMD_SET_COLOR, 3, 10, 20, 30,
+        firmware::CMD_SET_BRIGHTNESS, 1, 50,
+        firmware::CMD_SET_MODE, 1, firmware::EFFECT_MODE_BREATHING,
+    });
+    firmware::Rgb color = {};
+    CHECK(firmware::effects_get_color(color));
+    CHECK_EQ(color.r, 10);
+    CHECK_EQ(color.g, 20);
+    CHECK_EQ(color.b, 30);
+    CHECK_EQ(firmware::led_get_brightness(), 50);
+    CHECK_EQ(firmware::effects_get_mode(), firmware::EFFECT_MODE_BREATHING);
+}
+
+void test_batch_shows_one_frame()
+{
+    // Calibration and format each show at once on their own; batched, only the
+    // final state reaches the LEDs.
+    start_static();
+    const uint32_t before = mock_led_output_frame_count();
+    send(firmware::CMD_BATCH, {
+        firmware::CMD_SET_CALIBRATION, 6, 255, 0, 0, 20, 20, 20,
+        firmware::CMD_SET_OUTPUT_FORMAT, 2, 0, firmware::PIXEL_FORMAT_RGB,
+    });
+    CHECK_EQ(mock_led_output_frame_count(), before + 1);
+    // Red only, in the first byte of an RGB word.
+    const uint32_t word = host::mock_led_output_last_frame().words[0];
+    CHECK(word != 0);
+    CHECK_EQ(word & 0x00FFFFFFu, 0);
+}
+
+void test_batch_skips_nested_and_internal_commands()
+{
+    start_static();
+    send(firmware::CMD_BATCH, {
+        firmware::CMD_SET_BRIGHTNESS, 1, 60,
+        firmware::CMD_BATCH, 3, firmware::CMD_SET_BRIGHTNESS, 1, 20,
+        firmware::CMD_INTERNAL_USB_UNMOUNTED, 0,
+        firmware::CMD_GET_TELEMETRY, 1, 0,
+        firmware::CMD_SET_EFFECT_SPEED, 1, 70,
+    });
+    // The nested batch did not run and the fake unmount did not turn the LEDs off,
+    // while the entries around them were applied.
+    CHECK_EQ(firmware::led_get_brightness(), 60);
+    CHECK_EQ(firmware::effects_get_mode(), firmware::EFFECT_MODE_STATIC);
+    CHECK_EQ(firmware::effect_speed, 70);
+}
+
+void test_batch_stops_at_terminator()
+{
+    start_static();
+    send(firmware::CMD_BATCH, {
+        firmware::CMD_SET_BRIGHTNESS, 1, 30,
+        0, 0,
+        firmware::CMD_SET_BRIGHTNESS, 1, 80,
+    });
+    CHECK_EQ(firmware::led_get_brightness(), 30);
+}
+
+void test_truncated_entry_is_not_applied()
+{
+    start_static();
+    send(firmware::CMD_BATCH, {
+        firmware::CMD_SET_BRIGHTNESS, 1, 30,
+        firmware::CMD_SET_MODE, 4, firmware::EFFECT_MODE_RAINBOW,
+    });
+    CHECK_EQ(firmware::led_get_brightness(), 30);
+    CHECK_EQ(firmware::effects_get_mode(), firmware::EFFECT_MODE_STATIC);
+}
+
+} // namespace
+
+int main()
+{
+    RUN_TEST(test_batch_applies_every_entry);
+    RUN_TEST(test_batch_shows_one_frame);
+    RUN_TEST(test_batch_skips_nested_and_internal_commands);
+    RUN_TEST(test_batch_stops_at_terminator);
+    RUN_TEST(test_truncated_entry_is_not_applied);
+    return host::checks_passed() ? 0 : 1;
+}
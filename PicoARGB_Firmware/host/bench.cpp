@@ -0,0 +1,243 @@
+#include <chrono>
+#include <stdio.h>
+
+#include "config.h"
+#include "effects.h"
+#include "fake_clock.h"
+#include "led_driver.h"
+#include "mock_led_output.h"
+#include "pixel_format.h"
+#include "protocol.h"
+#include "scenario.h"
+
+// Renders every effect mode on the host against the mock LED output and reports the
+// cost of one frame (render plus packing) for a few strip lengths. The hash is of
+// the last packed frame; golden_test checks the rendered output itself.
+namespace {
+
+using firmware::protocol_execute;
+using host::advance_frame;
+using host::reset_firmware;
+using host::set_mode;
+
+constexpr uint16_t LED_COUNTS[] = {8, 144, 1000};
+constexpr uint32_t PIXELS_PER_RUN = 4000000;
+constexpr uint32_t FRAME_US = 1000000u / firmware::DEFAULT_FRAME_RATE;
+constexpr uint8_t SPECTRUM_BANDS = 16;
+
+struct BenchMode {
+    const char* name;
+    uint8_t mode;
+};
+
+constexpr BenchMode MODES[] = {
+    {"static", firmware::EFFECT_MODE_STATIC},
+    {"rainbow", firmware::EFFECT_MODE_RAINBOW},
+    {"breathing", firmware::EFFECT_MODE_BREATHING},
+    {"chase", firmware::EFFECT_MODE_CHASE},
+    {"music_vu", firmware::EFFECT_MODE_MUSIC_VU},
+    {"color_cycle", firmware::EFFECT_MODE_COLOR_CYCLE},
+    {"spectrum_bar", firmware::EFFECT_MODE_SPECTRUM_BARS},
+    {"spectrum", firmware::EFFECT_MODE_SPECTRUM},
+};
+
+uint32_t frames_for(uint16_t led_count)
+{
+    const uint32_t frames = PIXELS_PER_RUN / led_count;
+    return (frames < 200) ? 200 : frames;
+}
+
+void report(const char* name, uint16_t led_count, uint32_t frames, std::chrono::nanoseconds elapsed)
+{
+    const double ns_per_frame = static_cast<double>(elapsed.count()) / frames;
+    printf("%-12s %5u %8u %12.1f %8.2f  %08x\n", name, led_count, frames, ns_per_frame,
+        ns_per_frame / led_count, host::mock_led_output_hash());
+}
+
+// Renders the current setup for the usual number of frames and reports it.
+void run_frames(const char* name, uint16_t led_count)
+{
+    const uint32_t frames = frames_for(led_count);
+    const auto start = std::chrono::steady_clock::now();
+    for (uint32_t frame = 0; frame < frames; frame++) {
+        advance_frame(FRAME_US);
+    }
+    report(name, led_count, frames, std::chrono::steady_clock::now() - start);
+}
+
+void bench_mode(const BenchMode& bench, uint16_t led_count, uint8_t format = firmware::PIXEL_FORMAT_GRB)
+{
+    reset_firmware(led_count);
+    set_mode(bench.mode);
+    const uint8_t output_format[2] = {0, format};
+    protocol_execute(firmware::CMD_SET_OUTPUT_FORMAT, output_format, sizeof(output_format));
+
+    const uint32_t frames = frames_for(led_count);
+    const auto start = std::chrono::steady_clock::now();
+    for (uint32_t frame = 0; frame < frames; frame++) {
+        host::fake_clock_advance_us(FRAME_US);
+        if (bench.mode == firmware::EFFECT_MODE_MUSIC_VU) {
+            firmware::effects_set_music_level(static_cast<uint8_t>((frame * 37u) & 0xFFu));
+        } else if (bench.mode == firmware::EFFECT_MODE_SPECTRUM_BARS || bench.mode == firmware::EFFECT_MODE_SPECTRUM) {
+            uint8_t spectrum[1 + SPECTRUM_BANDS] = {SPECTRUM_BANDS};
+            for (uint32_t band = 0; band < SPECTRUM_BANDS; band++) {
+                spectrum[1 + band] = static_cast<uint8_t>((frame * 37u + band * 61u) & 0xFFu);
+            }
+            protocol_execute(firmware::CMD_SPECTRUM, spectrum, sizeof(spectrum));
+        } else if (bench.mode == firmware::EFFECT_MODE_STATIC) {
+            // Static only renders when the color changes, so re-send it every frame.
+            const uint8_t color[3] = {static_cast<uint8_t>(frame), 96, 16};
+            protocol_execute(firmware::CMD_SET_COLOR, color, sizeof(color));
+        }
+        firmware::effects_update(to_ms_since_boot(get_absolute_time()));
+    }
+    report(bench.name, led_count, frames, std::chrono::steady_clock::now() - start);
+}
+
+struct BenchFormat {
+    const char* name;
+    uint8_t format;
+};
+
+constexpr BenchFormat FORMATS[] = {
+    {"fmt_rgb", firmware::PIXEL_FORMAT_RGB},
+    {"fmt_grbw", firmware::PIXEL_FORMAT_GRBW},
+    {"fmt_grb16", firmware::PIXEL_FORMAT_GRB16},
+};
+
+// The static row packed for another chipset on output 0; compare with the GRB static
+// row. Its colors are never saturated, so GRBW lights the white channel every frame.
+void bench_format(const BenchFormat& bench, uint16_t led_count)
+{
+    bench_mode({bench.name, firmware::EFFECT_MODE_STATIC}, led_count, bench.format);
+}
+
+// Rainbow through a non-default calibration; costs the same per frame as the plain
+// rainbow row, since the curves are folded into the output tables.
+void bench_calibration(uint16_t led_count)
+{
+    reset_firmware(led_count);
+    set_mode(firmware::EFFECT_MODE_RAINBOW);
+    const uint8_t calibration[6] = {255, 224, 200, 22, 20, 24};
+    protocol_execute(firmware::CMD_SET_CALIBRATION, calibration, sizeof(calibration));
+
+    run_frames("calibrated", led_count);
+}
+
+// Full white under a budget of a third of its estimated draw, so the limiter scales
+// every frame; compare with the static row for the cost of the reduction.
+void bench_power_limit(uint16_t led_count)
+{
+    reset_firmware(led_count);
+    set_mode(firmware::EFFECT_MODE_STATIC);
+    const uint16_t budget_ma = static_cast<uint16_t>(led_count * firmware::DEFAULT_CHANNEL_MA);
+    const uint8_t limit[2] = {static_cast<uint8_t>(budget_ma), static_cast<uint8_t>(budget_ma >> 8)};
+    protocol_execute(firmware::CMD_SET_POWER_LIMIT, limit, sizeof(limit));
+
+    const uint32_t frames = frames_for(led_count);
+    const auto start = std::chrono::steady_clock::now();
+    for (uint32_t frame = 0; frame < frames; frame++) {
+        host::fake_clock_advance_us(FRAME_US);
+        const uint8_t color[3] = {255, 255, static_cast<uint8_t>(255 - (frame & 1u))};
+        protocol_execute(firmware::CMD_SET_COLOR, color, sizeof(color));
+        firmware::effects_update(to_ms_since_boot(get_absolute_time()));
+    }
+    report("power_limit", led_count, frames, std::chrono::steady_clock::now() - start);
+}
+
+// Rainbow base with `layer_count` full-length overlays, cycling through the blend modes.
+void bench_layers(uint8_t layer_count, uint16_t led_count)
+{
+    reset_firmware(led_count);
+    set_mode(firmware::EFFECT_MODE_RAINBOW);
+
+    constexpr uint8_t LAYER_MODES[] = {firmware::EFFECT_MODE_CHASE, firmware::EFFECT_MODE_BREATHING,
+        firmware::EFFECT_MODE_COLOR_CYCLE, firmware::EFFECT_MODE_RAINBOW};
+    for (uint8_t layer = 0; layer < layer_count; layer++) {
+        const uint8_t payload[8] = {layer, LAYER_MODES[layer], static_cast<uint8_t>(layer % 4), 128, 0, 0,
+            static_cast<uint8_t>(led_count), static_cast<uint8_t>(led_count >> 8)};
+        protocol_execute(firmware::CMD_SET_LAYER, payload, sizeof(payload));
+    }
+
+    char name[16];
+    snprintf(name, sizeof(name), "layers+%u", layer_count);
+    run_frames(name, led_count);
+}
+
+// Rainbow base split into two zones: the first half repeats one reversed, rotated
+// chase over four units with its own color, the second half breathes at its own speed.
+void bench_zones(uint16_t led_count)
+{
+    reset_firmware(led_count);
+    set_mode(firmware::EFFECT_MODE_RAINBOW);
+
+    const uint16_t half = led_count / 2;
+    const uint16_t rest = led_count - half;
+    const uint8_t fans[13] = {0, firmware::EFFECT_MODE_CHASE, 0, 0, static_cast<uint8_t>(half),
+        static_cast<uint8_t>(half >> 8), firmware::ZONE_REVERSE | firmware::ZONE_OWN_COLOR, 4, 3, 0, 64, 255,
+        firmware::ZONE_SPEED_GLOBAL};
+    protocol_execute(firmware::CMD_SET_ZONE, fans, sizeof(fans));
+    const uint8_t strip[13] = {1, firmware::EFFECT_MODE_BREATHING, static_cast<uint8_t>(half),
+        static_cast<uint8_t>(half >> 8), static_cast<uint8_t>(rest), static_cast<uint8_t>(rest >> 8), 0, 1, 0, 0,
+        0, 0, 80};
+    protocol_execute(firmware::CMD_SET_ZONE, strip, sizeof(strip));
+
+    run_frames("zones", led_count);
+}
+
+// An uploaded animation played from RAM at the effect frame rate.
+void bench_animation(uint16_t led_count)
+{
+    reset_firmware(led_count);
+    host::upload_animation(host::build_animation(led_count, static_cast<uint16_t>(FRAME_US / 1000u)));
+    run_frames("animation", led_count);
+}
+
+// Compare the ns/LED column of the program rows with the native rainbow and chase.
+template <size_t N>
+void bench_program(const char* name, const host::ProgramInstruction (&program)[N], uint16_t led_count)
+{
+    reset_firmware(led_count);
+    host::upload_program(program);
+    run_frames(name, led_count);
+}
+
+// Host-rendered frames arriving as HID-sized DIRECT_PIXELS chunks, then a commit.
+void bench_direct(uint16_t led_count)
+{
+    reset_firmware(led_count);
+    set_mode(firmware::EFFECT_MODE_DIRECT);
+
+    const uint32_t frames = frames_for(led_count);
+    const auto start = std::chrono::steady_clock::now();
+    for (uint32_t frame = 0; frame < frames; frame++) {
+        host::send_direct_frame(led_count, frame);
+    }
+    report("direct", led_count, frames, std::chrono::steady_clock::now() - start);
+}
+
+} // namespace
+
+int main()
+{
+    printf("%-12s %5s %8s %12s %8s  %s\n", "mode", "leds", "frames", "ns/frame", "ns/led", "hash");
+    for (const uint16_t led_count : LED_COUNTS) {
+        for (const BenchMode& bench : MODES) {
+            bench_mode(bench, led_count);
+        }
+        for (const BenchFormat& bench : FORMATS) {
+            bench_format(bench, led_count);
+        }
+        bench_calibration(led_count);
+        bench_power_limit(led_count);
+        for (uint8_t layer_count = 1; layer_count <= firmware::MAX_LAYERS; layer_count++) {
+            bench_layers(layer_count, led_count);
+        }
+        bench_zones(led_count);
+        bench_animation(led_count);
+        bench_program("vm_rainbow", host::RAINBOW_PROGRAM, led_count);
+        bench_program("vm_chase", host::CHASE_PROGRAM, led_count);
+        bench_direct(led_count);
+    }
+    return 0;
+}
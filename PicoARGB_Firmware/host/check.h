@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+
+// Minimal assertions for the host tests. A failed check prints its location and
+// fails the run; main() returns checks_passed() ? 0 : 1 after running every test.
+namespace host {
+
+inline uint32_t check_failures = 0;
+
+inline bool check(bool ok, const char* expression, const char* file, int line)
+{
+    if (!ok) {
+        printf("%s:%d: CHECK(%s) failed\n", file, line, expression);
+        check_failures++;
+    }
+    return ok;
+}
+
+inline bool check_equal(uint64_t actual, uint64_t expected, const char* expression, const char* file, int line)
+{
+    if (actual != expected) {
+        printf("%s:%d: CHECK_EQ(%s) failed: got %llu (0x%llx), expected %llu (0x%llx)\n", file, line, expression,
+            static_cast<unsigned long long>(actual), static_cast<unsigned long long>(actual),
+            static_cast<unsigned long long>(expected), static_cast<unsigned long long>(expected));
+        check_failures++;
+    }
+    return actual == expected;
+}
+
+// Runs one test function and reports it by name.
+inline void run_test(const char* name, void (*test)())
+{
+    const uint32_t failures = check_failures;
+    test();
+    printf("%-48s %s\n", name, (check_failures == failures) ? "ok" : "FAILED");
+}
+
+inline bool checks_passed()
+{
+    return check_failures == 0;
+}
+
+} // namespace host
+
+#define CHECK(expression) host::check((expression), #expression, __FILE__, __LINE__)
+#define CHECK_EQ(actual, expected) \
+    host::check_equal(static_cast<uint64_t>(actual), static_cast<uint64_t>(expected), #actual ", " #expected, \
+        __FILE__, __LINE__)
+#define RUN_TEST(test) host::run_test(#test, test)
@@ -0,0 +1,102 @@
+#include <string.h>
+#include <vector>
+
+#include "check.h"
+#include "command_queue.h"
+#include "config.h"
+#include "effects.h"
+#include "mock_led_output.h"
+#include "protocol.h"
+#include "scenario.h"
+
+// The cross-core handoff of streamed frames: a whole frame crosses in the command
+// queue's frame stage with one queued command, as the vendor stream sends it, and
+// shows the same as the same pixels sent over HID.
+namespace {
+
+constexpr uint16_t LED_COUNT = 60;
+
+std::vector<uint8_t> ramp(uint16_t pixels, uint8_t seed)
+{
+    std::vector<uint8_t> rgb(pixels * 3u);
+    for (size_t i = 0; i < rgb.size(); i++) {
+        rgb[i] = static_cast<uint8_t>(seed + i);
+    }
+    return rgb;
+}
+
+// What the USB core does at the end of a vendor DIRECT_PIXELS frame.
+void hand_over(uint16_t offset, const std::vector<uint8_t>& rgb)
+{
+    uint8_t* stage = firmware::command_queue_stage();
+    CHECK(stage != nullptr);
+    if (stage == nullptr) {
+        return;
+    }
+    memcpy(stage, rgb.data(), rgb.size());
+    firmware::HostCommand* slot = firmware::command_queue_reserve();
+    const uint16_t pixels = static_cast<uint16_t>(rgb.size() / 3u);
+    slot->command = firmware::CMD_INTERNAL_DIRECT_FRAME;
+    slot->payload[0] = static_cast<uint8_t>(offset);
+    slot->payload[1] = static_cast<uint8_t>(offset >> 8);
+    slot->payload[2] = static_cast<uint8_t>(pixels);
+    slot->payload[3] = static_cast<uint8_t>(pixels >> 8);
+    slot->payload_size = 4;
+    firmware::command_queue_stage_handoff();
+    firmware::command_queue_commit();
+}
+
+std::vector<uint32_t> last_frame()
+{
+    const host::RecordedFrame frame = host::mock_led_output_last_frame();
+    return std::vector<uint32_t>(frame.words, frame.words + frame.length);
+}
+
+void test_staged_frame_matches_hid_frame()
+{
+    host::reset_firmware(LED_COUNT);
+    const std::vector<uint8_t> rgb = ramp(LED_COUNT, 7);
+    uint8_t payload[3 + 20 * 3];
+    for (uint16_t offset = 0; offset < LED_COUNT; offset = static_cast<uint16_t>(offset + 20)) {
+        payload[0] = static_cast<uint8_t>(offset);
+        payload[1] = 0;
+        payload[2] = 20;
+        memcpy(&payload[3], &rgb[offset * 3u], 20 * 3);
+        firmware::protocol_execute(firmware::CMD_DIRECT_PIXELS, payload, sizeof(payload));
+    }
+    firmware::protocol_execute(firmware::CMD_DIRECT_COMMIT, nullptr, 0);
+    const std::vector<uint32_t> over_hid = last_frame();
+
+    host::reset_firmware(LED_COUNT);
+    hand_over(0, rgb);
+    // The render core owns the stage until it has applied the frame.
+    CHECK(firmware::command_queue_stage() == nullptr);
+    firmware::protocol_process_commands();
+    CHECK(firmware::command_queue_stage() != nullptr);
+    CHECK_EQ(firmware::effects_get_mode(), firmware::EFFECT_MODE_DIRECT);
+
+    firmware::protocol_execute(firmware::CMD_DIRECT_COMMIT, nullptr, 0);
+    CHECK(last_frame() == over_hid);
+}
+
+void test_staged_frame_past_strip_end_is_clipped()
+{
+    host::reset_firmware(LED_COUNT);
+    hand_over(LED_COUNT - 10, ramp(20, 1));
+    firmware::protocol_process_commands();
+    firmware::protocol_execute(firmware::CMD_DIRECT_COMMIT, nullptr, 0);
+    const std::vector<uint32_t> frame = last_frame();
+    CHECK_EQ(frame.size(), LED_COUNT);
+    CHECK_EQ(frame[0], 0);
+    CHECK(frame[LED_COUNT - 1] != 0);
+    CHECK(firmware::command_queue_stage() != nullptr);
+}
+
+} // namespace
+
+int main()
+{
+    RUN_TEST(test_staged_frame_matches_hid_frame);
+    RUN_TEST(test_staged_frame_past_strip_end_is_clipped);
+    return host::checks_passed() ? 0 : 1;
+}
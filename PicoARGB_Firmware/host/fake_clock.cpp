@@ -0,0 +1,42 @@
+#include "fake_clock.h"
+
+#include "pico/stdlib.h"
+
+namespace host {
+namespace {
+
+uint64_t now_us = 0;
+
+} // namespace
+
+void fake_clock_set_us(uint64_t value)
+{
+    now_us = value;
+}
+
+void fake_clock_advance_us(uint64_t delta_us)
+{
+    now_us += delta_us;
+}
+
+uint64_t fake_clock_now_us()
+{
+    return now_us;
+}
+
+} // namespace host
+
+absolute_time_t get_absolute_time()
+{
+    return host::fake_clock_now_us();
+}
+
+uint32_t time_us_32()
+{
+    return static_cast<uint32_t>(host::fake_clock_now_us());
+}
+
+uint64_t time_us_64()
+{
+    return host::fake_clock_now_us();
+}
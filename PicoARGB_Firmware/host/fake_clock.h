@@ -0,0 +1,13 @@
+#pragma once
+
+#include <stdint.h>
+
+namespace host {
+
+// Time seen by the firmware through get_absolute_time() and time_us_32(). It only
+// moves when the caller advances it, so renders are reproducible.
+void fake_clock_set_us(uint64_t now_us);
+void fake_clock_advance_us(uint64_t delta_us);
+uint64_t fake_clock_now_us();
+
+} // namespace host
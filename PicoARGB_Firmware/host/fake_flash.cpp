@@ -0,0 +1,44 @@
+#include <string.h>
+
+#include "hardware/flash.h"
+#include "pico/flash.h"
+
+uint8_t host_flash_image[PICO_FLASH_SIZE_BYTES];
+
+namespace {
+
+// Flash comes up erased, like a blank chip.
+struct ErasedImage {
+    ErasedImage()
+    {
+        memset(host_flash_image, 0xFF, sizeof(host_flash_image));
+    }
+};
+
+ErasedImage erased_image;
+
+} // namespace
+
+void flash_range_erase(uint32_t flash_offs, size_t count)
+{
+    memset(&host_flash_image[flash_offs], 0xFF, count);
+}
+
+void flash_range_program(uint32_t flash_offs, const uint8_t* data, size_t count)
+{
+    for (size_t i = 0; i < count; i++) {
+        host_flash_image[flash_offs + i] &= data[i];
+    }
+}
+
+int flash_safe_execute(void (*func)(void*), void* param, uint32_t enter_exit_timeout_ms)
+{
+    (void)enter_exit_timeout_ms;
+    func(param);
+    return PICO_OK;
+}
+
+bool flash_safe_execute_core_init()
+{
+    return true;
+}
@@ -0,0 +1,185 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "fixed_math.h"
+
+// Checks the fixed-point helpers the effects use against the float expressions they
+// replaced, on the 8-bit scale the effects output: every case must stay within
+// 1 LSB of the float reference.
+namespace {
+
+using firmware::Rgb;
+
+constexpr int MAX_ERROR_LSB = 1;
+constexpr float PI_F = 3.14159265358979f;
+
+struct CheckResult {
+    const char* name;
+    int max_error;
+    uint32_t samples;
+};
+
+void track(CheckResult& result, int expected, int actual)
+{
+    const int error = abs(expected - actual);
+    if (error > result.max_error) {
+        result.max_error = error;
+    }
+    result.samples++;
+}
+
+void track(CheckResult& result, Rgb expected, Rgb actual)
+{
+    track(result, expected.r, actual.r);
+    track(result, expected.g, actual.g);
+    track(result, expected.b, actual.b);
+}
+
+// The float HSV converter the effects used before the port; hue in degrees.
+Rgb reference_hsv(float hue, float saturation, float value)
+{
+    const float c = value * saturation;
+    const float x = c * (1.0f - fabsf(fmodf(hue / 60.0f, 2.0f) - 1.0f));
+    const float m = value - c;
+
+    float r = 0.0f;
+    float g = 0.0f;
+    float b = 0.0f;
+    if (hue < 60.0f) {
+        r = c; g = x;
+    } else if (hue < 120.0f) {
+        r = x; g = c;
+    } else if (hue < 180.0f) {
+        g = c; b = x;
+    } else if (hue < 240.0f) {
+        g = x; b = c;
+    } else if (hue < 300.0f) {
+        r = x; b = c;
+    } else {
+        r = c; b = x;
+    }
+    return {static_cast<uint8_t>((r + m) * 255.0f), static_cast<uint8_t>((g + m) * 255.0f),
+        static_cast<uint8_t>((b + m) * 255.0f)};
+}
+
+float clamp01(float value)
+{
+    return (value < 0.0f) ? 0.0f : ((value > 1.0f) ? 1.0f : value);
+}
+
+Rgb reference_scale(Rgb color, float intensity)
+{
+    const float safe = clamp01(intensity);
+    return {static_cast<uint8_t>(color.r * safe), static_cast<uint8_t>(color.g * safe),
+        static_cast<uint8_t>(color.b * safe)};
+}
+
+uint8_t reference_lerp(uint8_t a, uint8_t b, float t)
+{
+    return static_cast<uint8_t>(static_cast<float>(a) + ((static_cast<float>(b) - static_cast<float>(a)) * clamp01(t)));
+}
+
+CheckResult check_hsv_full()
+{
+    CheckResult result = {"hsv every hue", 0, 0};
+    for (uint32_t hue = 0; hue < 65536; hue++) {
+        const float degrees = static_cast<float>(hue) * 360.0f / 65536.0f;
+        track(result, reference_hsv(degrees, 1.0f, 1.0f), firmware::hsv_to_rgb(static_cast<uint16_t>(hue), 255, 255));
+    }
+    return result;
+}
+
+CheckResult check_hsv_saturation_value()
+{
+    CheckResult result = {"hsv s/v sweep", 0, 0};
+    for (uint32_t hue = 0; hue < 65536; hue += 97) {
+        const float degrees = static_cast<float>(hue) * 360.0f / 65536.0f;
+        for (uint32_t saturation = 0; saturation <= 255; saturation += 15) {
+            for (uint32_t value = 0; value <= 255; value += 15) {
+                track(result, reference_hsv(degrees, saturation / 255.0f, value / 255.0f),
+                    firmware::hsv_to_rgb(static_cast<uint16_t>(hue), static_cast<uint8_t>(saturation),
+                        static_cast<uint8_t>(value)));
+            }
+        }
+    }
+    return result;
+}
+
+// sin() as a 0..255 intensity, the way breathing and the connection pulse use it.
+CheckResult check_sine()
+{
+    CheckResult result = {"sin_q15", 0, 0};
+    for (uint32_t step = 0; step < (1u << 16); step++) {
+        const uint32_t phase = step << 16;
+        const float turns = static_cast<float>(phase) / 4294967296.0f;
+        const int expected = static_cast<int>(lroundf((sinf(2.0f * PI_F * turns) + 1.0f) * 127.5f));
+        const int actual = ((firmware::sin_q15(phase) + 32767) * 255 + 32767) / 65534;
+        track(result, expected, actual);
+    }
+    return result;
+}
+
+// The music wheel's level^0.65 curve, as a 0..255 intensity.
+CheckResult check_power_curve()
+{
+    constexpr firmware::detail::CurveTable CURVE = firmware::detail::make_power_table(0.65);
+    CheckResult result = {"curve_q16 pow 0.65", 0, 0};
+    for (uint32_t level = 0; level <= firmware::Q16_ONE; level++) {
+        const float x = static_cast<float>(level) / 65536.0f;
+        const int expected = static_cast<int>(lroundf(powf(x, 0.65f) * 255.0f));
+        const int actual = static_cast<int>((firmware::curve_q16(CURVE, level) * 255u + 32768u) >> 16);
+        track(result, expected, actual);
+    }
+    return result;
+}
+
+CheckResult check_scale()
+{
+    CheckResult result = {"scale_color", 0, 0};
+    for (uint32_t channel = 0; channel <= 255; channel += 3) {
+        const Rgb color = {static_cast<uint8_t>(channel), static_cast<uint8_t>(255 - channel), 255};
+        for (uint32_t intensity = 0; intensity <= firmware::Q16_ONE; intensity += 61) {
+            track(result, reference_scale(color, static_cast<float>(intensity) / 65536.0f),
+                firmware::scale_color(color, intensity));
+        }
+    }
+    return result;
+}
+
+CheckResult check_lerp()
+{
+    CheckResult result = {"lerp_u8", 0, 0};
+    for (uint32_t a = 0; a <= 255; a += 5) {
+        for (uint32_t b = 0; b <= 255; b += 5) {
+            for (uint32_t t = 0; t <= firmware::Q16_ONE; t += 509) {
+                track(result, reference_lerp(static_cast<uint8_t>(a), static_cast<uint8_t>(b), t / 65536.0f),
+                    firmware::lerp_u8(static_cast<uint8_t>(a), static_cast<uint8_t>(b), t));
+            }
+        }
+    }
+    return result;
+}
+
+} // namespace
+
+int main()
+{
+    const CheckResult results[] = {
+        check_hsv_full(),
+        check_hsv_saturation_value(),
+        check_sine(),
+        check_power_curve(),
+        check_scale(),
+        check_lerp(),
+    };
+
+    int failures = 0;
+    for (const CheckResult& result : results) {
+        const bool ok = result.max_error <= MAX_ERROR_LSB;
+        printf("%-20s %8u samples  max error %d LSB  %s\n", result.name, result.samples, result.max_error,
+            ok ? "ok" : "FAILED");
+        failures += ok ? 0 : 1;
+    }
+    return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,659 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <map>
+#include <string>
+
+#include "config.h"
+#include "effects.h"
+#include "led_driver.h"
+#include "mock_led_output.h"
+#include "pixel_format.h"
+#include "protocol.h"
+#include "scenario.h"
+
+// Golden-frame regression test: renders fixed scenarios (every effect mode, the layer
+// blends, zones, each output format and the output-stage settings) and compares a
+// hash of every frame sent against golden_frames.txt. Run with --update to rewrite
+// the goldens after an intended change to the output, and review the diff. Each case
+// also checks what its last frame must look like, so a golden rewritten over a bug
+// still fails.
+namespace {
+
+using firmware::protocol_execute;
+using host::RecordedFrame;
+using host::reset_firmware;
+using host::set_mode;
+
+constexpr uint16_t LED_COUNT = 60;
+constexpr uint32_t FRAMES = 120;
+constexpr uint32_t FRAME_US = 1000000u / firmware::DEFAULT_FRAME_RATE;
+constexpr uint8_t SPECTRUM_BANDS = 16;
+
+struct GoldenCase {
+    const char* name;
+    // Configures the firmware after reset_firmware().
+    void (*setup)();
+    // Runs before each frame, for scenarios fed by the host; may be null.
+    void (*feed)(uint32_t frame);
+    // Checks the last frame sent; returns what is wrong with it, or null.
+    const char* (*verify)(const RecordedFrame& frame);
+};
+
+void set_output_format(uint8_t output, uint8_t format)
+{
+    const uint8_t payload[2] = {output, format};
+    protocol_execute(firmware::CMD_SET_OUTPUT_FORMAT, payload, sizeof(payload));
+}
+
+void set_layer(uint8_t mode, uint8_t blend)
+{
+    // Layer 0 over the middle half of the strip, at half opacity.
+    const uint8_t payload[8] = {0, mode, blend, 128, LED_COUNT / 4, 0, LED_COUNT / 2, 0};
+    protocol_execute(firmware::CMD_SET_LAYER, payload, sizeof(payload));
+}
+
+void feed_music(uint32_t frame)
+{
+    firmware::effects_set_music_level(static_cast<uint8_t>((frame * 37u) & 0xFFu));
+}
+
+void feed_spectrum(uint32_t frame)
+{
+    uint8_t spectrum[1 + SPECTRUM_BANDS] = {SPECTRUM_BANDS};
+    for (uint32_t band = 0; band < SPECTRUM_BANDS; band++) {
+        spectrum[1 + band] = static_cast<uint8_t>((frame * 37u + band * 61u) & 0xFFu);
+    }
+    protocol_execute(firmware::CMD_SPECTRUM, spectrum, sizeof(spectrum));
+}
+
+void feed_direct(uint32_t frame)
+{
+    host::send_direct_frame(LED_COUNT, frame * 7u);
+}
+
+void feed_static_color(uint32_t frame)
+{
+    const uint8_t color[3] = {static_cast<uint8_t>(frame * 2u), 96, 16};
+    protocol_execute(firmware::CMD_SET_COLOR, color, sizeof(color));
+}
+
+// Direct frames are ramps, so most pixels have a non-zero common part and the GRBW
+// white channel and the low byte of 16-bit formats are exercised.
+void setup_direct()
+{
+    set_mode(firmware::EFFECT_MODE_DIRECT);
+}
+
+// Channels of a packed pixel on the 8-bit scale.
+struct Channels {
+    int r;
+    int g;
+    int b;
+};
+
+Channels unpack(const RecordedFrame& frame, uint16_t index, uint8_t format = firmware::PIXEL_FORMAT_GRB)
+{
+    const uint32_t* words = frame.words;
+    switch (format) {
+    case firmware::PIXEL_FORMAT_RGB: {
+        const uint32_t word = words[index];
+        return {static_cast<int>(word >> 24), static_cast<int>((word >> 16) & 0xFFu),
+            static_cast<int>((word >> 8) & 0xFFu)};
+    }
+    case firmware::PIXEL_FORMAT_BRG: {
+        const uint32_t word = words[index];
+        return {static_cast<int>((word >> 16) & 0xFFu), static_cast<int>((word >> 8) & 0xFFu),
+            static_cast<int>(word >> 24)};
+    }
+    case firmware::PIXEL_FORMAT_GRBW: {
+        // The white LED carries the common part; add it back.
+        const uint32_t word = words[index];
+        const int w = static_cast<int>(word & 0xFFu);
+        return {static_cast<int>((word >> 16) & 0xFFu) + w, static_cast<int>(word >> 24) + w,
+            static_cast<int>((word >> 8) & 0xFFu) + w};
+    }
+    case firmware::PIXEL_FORMAT_GRB16: {
+        const uint32_t high = words[index * 2];
+        const uint32_t low = words[index * 2 + 1];
+        return {static_cast<int>(((high & 0xFF00u) | (low >> 24)) >> 8), static_cast<int>(high >> 24),
+            static_cast<int>((low >> 16) & 0xFFu)};
+    }
+    default: {
+        const uint32_t word = words[index];
+        return {static_cast<int>((word >> 16) & 0xFFu), static_cast<int>(word >> 24),
+            static_cast<int>((word >> 8) & 0xFFu)};
+    }
+    }
+}
+
+// An 8-bit input after the default gamma, as the output LUT should produce it.
+double gamma_of(uint8_t value)
+{
+    return 255.0 * pow(value / 255.0, firmware::DEFAULT_GAMMA_TENTHS / 10.0);
+}
+
+bool near(int actual, double expected, double tolerance)
+{
+    return fabs(actual - expected) <= tolerance;
+}
+
+bool near(Channels actual, Channels expected, int tolerance)
+{
+    return abs(actual.r - expected.r) <= tolerance && abs(actual.g - expected.g) <= tolerance
+        && abs(actual.b - expected.b) <= tolerance;
+}
+
+// Fully saturated at full value: one channel off and one at full scale, as HSV with
+// s = v = 255 gives.
+bool saturated(Channels pixel)
+{
+    const int low = std::min({pixel.r, pixel.g, pixel.b});
+    const int high = std::max({pixel.r, pixel.g, pixel.b});
+    return low == 0 && high == 255;
+}
+
+bool lit(Channels pixel)
+{
+    return pixel.r != 0 || pixel.g != 0 || pixel.b != 0;
+}
+
+bool uniform(const RecordedFrame& frame, uint16_t from, uint16_t to)
+{
+    for (uint16_t i = from + 1; i < to; i++) {
+        if (frame.words[i] != frame.words[from]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool saturated_over(const RecordedFrame& frame, uint16_t from, uint16_t to)
+{
+    for (uint16_t i = from; i < to; i++) {
+        if (!saturated(unpack(frame, i))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// The base color keeps its channel order when scaled.
+bool base_color_order(Channels pixel)
+{
+    return pixel.r >= pixel.g && pixel.g >= pixel.b;
+}
+
+// A dot of the base color fading out within 2.5 LEDs of its head: at most five LEDs
+// lit, the rest black.
+const char* verify_chase_dot(const RecordedFrame& frame)
+{
+    uint16_t count = 0;
+    for (uint16_t i = 0; i < LED_COUNT; i++) {
+        const Channels pixel = unpack(frame, i);
+        if (lit(pixel)) {
+            count++;
+            if (!base_color_order(pixel)) {
+                return "lit LED is not the base color";
+            }
+        }
+    }
+    return (count >= 1 && count <= 5) ? nullptr : "expected 1 to 5 lit LEDs";
+}
+
+// The direct feed of the last frame, through the default gamma, in `format`.
+const char* verify_direct_frame(const RecordedFrame& frame, uint8_t format)
+{
+    constexpr uint16_t CHUNK_PIXELS = 20;
+    const uint32_t seed = (FRAMES - 1) * 7u;
+    for (uint16_t i = 0; i < LED_COUNT; i++) {
+        const uint32_t offset = (i / CHUNK_PIXELS) * CHUNK_PIXELS;
+        const uint32_t first = seed + offset + (i - offset) * 3u;
+        const Channels pixel = unpack(frame, i, format);
+        // GRBW rounds the color and white parts separately.
+        const double tolerance = (format == firmware::PIXEL_FORMAT_GRBW) ? 2.0 : 1.0;
+        if (!near(pixel.r, gamma_of(static_cast<uint8_t>(first)), tolerance)
+            || !near(pixel.g, gamma_of(static_cast<uint8_t>(first + 1)), tolerance)
+            || !near(pixel.b, gamma_of(static_cast<uint8_t>(first + 2)), tolerance)) {
+            return "pixel differs from the direct frame sent";
+        }
+    }
+    return nullptr;
+}
+
+const char* verify_direct(const RecordedFrame& frame)
+{
+    return verify_direct_frame(frame, firmware::PIXEL_FORMAT_GRB);
+}
+
+const char* verify_format_rgb(const RecordedFrame& frame)
+{
+    return verify_direct_frame(frame, firmware::PIXEL_FORMAT_RGB);
+}
+
+const char* verify_format_brg(const RecordedFrame& frame)
+{
+    return verify_direct_frame(frame, firmware::PIXEL_FORMAT_BRG);
+}
+
+const char* verify_off(const RecordedFrame& frame)
+{
+    for (uint16_t i = 0; i < frame.length; i++) {
+        if (frame.words[i] != 0) {
+            return "LED lit while off";
+        }
+    }
+    return nullptr;
+}
+
+const char* verify_static(const RecordedFrame& frame)
+{
+    // The last color fed was {238, 96, 16}.
+    for (uint16_t i = 0; i < LED_COUNT; i++) {
+        const Channels pixel = unpack(frame, i);
+        if (!near(pixel.r, gamma_of(238), 1.0) || !near(pixel.g, gamma_of(96), 1.0)
+            || !near(pixel.b, gamma_of(16), 1.0)) {
+            return "pixel is not the color set";
+        }
+    }
+    return nullptr;
+}
+
+const char* verify_rainbow(const RecordedFrame& frame)
+{
+    if (!saturated_over(frame, 0, LED_COUNT)) {
+        return "rainbow pixel is not a saturated hue";
+    }
+    return (frame.words[0] != frame.words[LED_COUNT / 2]) ? nullptr : "opposite ends of the strip share a hue";
+}
+
+const char* verify_breathing(const RecordedFrame& frame)
+{
+    if (!uniform(frame, 0, LED_COUNT)) {
+        return "breathing is not uniform";
+    }
+    return base_color_order(unpack(frame, 0)) ? nullptr : "breathing is not the base color";
+}
+
+const char* verify_music_vu(const RecordedFrame& frame)
+{
+    return uniform(frame, 0, LED_COUNT) ? nullptr : "VU meter is not uniform";
+}
+
+const char* verify_color_cycle(const RecordedFrame& frame)
+{
+    if (!uniform(frame, 0, LED_COUNT)) {
+        return "color cycle is not uniform";
+    }
+    return saturated(unpack(frame, 0)) ? nullptr : "color cycle is not a saturated hue";
+}
+
+const char* verify_spectrum_bars(const RecordedFrame& frame)
+{
+    bool any = false;
+    for (uint32_t band = 0; band < SPECTRUM_BANDS; band++) {
+        const uint16_t start = static_cast<uint16_t>((band * LED_COUNT) / SPECTRUM_BANDS);
+        const uint16_t end = static_cast<uint16_t>(((band + 1) * LED_COUNT) / SPECTRUM_BANDS);
+        bool ended = false;
+        for (uint16_t i = start; i < end; i++) {
+            const bool on = lit(unpack(frame, i));
+            if (on && ended) {
+                return "bar has a gap";
+            }
+            ended = ended || !on;
+            any = any || on;
+        }
+    }
+    return any ? nullptr : "no bar lit";
+}
+
+const char* verify_spectrum(const RecordedFrame& frame)
+{
+    return uniform(frame, 0, LED_COUNT) ? "bands blend into one color" : nullptr;
+}
+
+const char* verify_animation(const RecordedFrame& frame)
+{
+    // Keyframe blue, with the white dots the deltas have set so far in one run.
+    const uint32_t blue = static_cast<uint32_t>(lround(gamma_of(64))) << 8;
+    uint16_t whites = 0;
+    uint16_t last_white = 0;
+    for (uint16_t i = 0; i < LED_COUNT; i++) {
+        if (frame.words[i] == 0xFFFFFF00u) {
+            whites++;
+            last_white = i;
+        } else if (!near(static_cast<int>(frame.words[i] >> 8), blue >> 8, 1.0)) {
+            return "pixel is neither the keyframe nor a dot";
+        }
+    }
+    return (last_white == whites) ? nullptr : "dots are not one run from LED 1";
+}
+
+const char* verify_layer_outside(const RecordedFrame& frame)
+{
+    // The layer covers [15, 45); the rainbow base shows untouched around it.
+    return (saturated_over(frame, 0, LED_COUNT / 4) && saturated_over(frame, LED_COUNT * 3 / 4, LED_COUNT))
+        ? nullptr
+        : "base outside the layer is not the rainbow";
+}
+
+const char* verify_layer_alpha(const RecordedFrame& frame)
+{
+    // Breathing outside the layer, rainbow mixed in inside it.
+    if (!uniform(frame, 0, LED_COUNT / 4) || frame.words[0] != frame.words[LED_COUNT - 1]) {
+        return "base outside the layer is not the breathing color";
+    }
+    return uniform(frame, LED_COUNT / 4, LED_COUNT * 3 / 4) ? "layer is not blended in" : nullptr;
+}
+
+const char* verify_zones(const RecordedFrame& frame)
+{
+    for (uint16_t i = 0; i < LED_COUNT / 2; i++) {
+        if (unpack(frame, i).r != 0) {
+            return "fan zone is not its own color";
+        }
+    }
+    return uniform(frame, LED_COUNT / 2, LED_COUNT) ? nullptr : "strip zone is not uniform";
+}
+
+const char* verify_format_grbw(const RecordedFrame& frame)
+{
+    for (uint16_t i = 0; i < LED_COUNT; i++) {
+        const uint32_t word = frame.words[i];
+        const uint32_t g = word >> 24;
+        const uint32_t r = (word >> 16) & 0xFFu;
+        const uint32_t b = (word >> 8) & 0xFFu;
+        if (g != 0 && r != 0 && b != 0) {
+            return "common part left in the color channels";
+        }
+    }
+    return verify_direct_frame(frame, firmware::PIXEL_FORMAT_GRBW);
+}
+
+const char* verify_format_grb16(const RecordedFrame& frame)
+{
+    // 8.8 channels reach the wire: the low bytes are not copies of the high bytes.
+    bool fractional = false;
+    for (uint16_t i = 0; i < LED_COUNT; i++) {
+        const uint32_t g16 = frame.words[i * 2] >> 16;
+        fractional = fractional || ((g16 & 0xFFu) != (g16 >> 8));
+    }
+    return fractional ? verify_direct_frame(frame, firmware::PIXEL_FORMAT_GRB16) : "16-bit channels are 8-bit";
+}
+
+const char* verify_outputs_mixed(const RecordedFrame& frame)
+{
+    constexpr uint16_t FIRST = 20;
+    if (!uniform(frame, 0, FIRST) || !uniform(frame, FIRST, LED_COUNT)) {
+        return "an output is not uniform";
+    }
+    // The same color on both outputs, with the common part on the white LED of the second.
+    const Channels grb = unpack(frame, 0);
+    const Channels grbw = unpack(frame, FIRST, firmware::PIXEL_FORMAT_GRBW);
+    if ((frame.words[FIRST] & 0xFFu) == 0) {
+        return "white LED is dark";
+    }
+    return near(grbw, grb, 2) ? nullptr : "outputs show different colors";
+}
+
+const char* verify_brightness_dither(const RecordedFrame& frame)
+{
+    // 30 % brightness caps every channel near 255 * 0.3^gamma; dither may round up.
+    const double ceiling = 255.0 * pow(0.3, firmware::DEFAULT_GAMMA_TENTHS / 10.0) + 1.0;
+    for (uint16_t i = 0; i < LED_COUNT; i++) {
+        const Channels pixel = unpack(frame, i);
+        if (pixel.r > ceiling || pixel.g > ceiling || pixel.b > ceiling) {
+            return "channel above the brightness limit";
+        }
+    }
+    return lit(unpack(frame, 0)) ? nullptr : "strip is dark";
+}
+
+const char* verify_calibration(const RecordedFrame& frame)
+{
+    bool full_red = false;
+    for (uint16_t i = 0; i < LED_COUNT; i++) {
+        const Channels pixel = unpack(frame, i);
+        if (pixel.g > 224 || pixel.b > 200) {
+            return "channel above its calibration gain";
+        }
+        full_red = full_red || pixel.r == 255;
+    }
+    return full_red ? nullptr : "red lost its full scale";
+}
+
+const char* verify_power_limit(const RecordedFrame& frame)
+{
+    // The power model: DEFAULT_CHANNEL_MA per channel at full scale plus an idle draw.
+    constexpr double BUDGET_MA = LED_COUNT * 10.0;
+    double estimate = 0.0;
+    for (uint16_t i = 0; i < LED_COUNT; i++) {
+        const Channels pixel = unpack(frame, i);
+        estimate += (pixel.r + pixel.g + pixel.b) * firmware::DEFAULT_CHANNEL_MA / 255.0
+            + firmware::DEFAULT_IDLE_TENTHS_MA / 10.0;
+    }
+    if (estimate > BUDGET_MA * 1.02) {
+        return "estimated current above the budget";
+    }
+    return verify_breathing(frame);
+}
+
+const GoldenCase CASES[] = {
+    {"off", [] { set_mode(firmware::EFFECT_MODE_OFF); }, nullptr, verify_off},
+    {"static", [] { set_mode(firmware::EFFECT_MODE_STATIC); }, feed_static_color, verify_static},
+    {"rainbow", [] { set_mode(firmware::EFFECT_MODE_RAINBOW); }, nullptr, verify_rainbow},
+    {"breathing", [] { set_mode(firmware::EFFECT_MODE_BREATHING); }, nullptr, verify_breathing},
+    {"chase", [] { set_mode(firmware::EFFECT_MODE_CHASE); }, nullptr, verify_chase_dot},
+    {"music_vu", [] { set_mode(firmware::EFFECT_MODE_MUSIC_VU); }, feed_music, verify_music_vu},
+    {"color_cycle", [] { set_mode(firmware::EFFECT_MODE_COLOR_CYCLE); }, nullptr, verify_color_cycle},
+    {"spectrum_bars", [] { set_mode(firmware::EFFECT_MODE_SPECTRUM_BARS); }, feed_spectrum, verify_spectrum_bars},
+    {"spectrum", [] { set_mode(firmware::EFFECT_MODE_SPECTRUM); }, feed_spectrum, verify_spectrum},
+    {"direct", setup_direct, feed_direct, verify_direct},
+    {"animation",
+        [] { host::upload_animation(host::build_animation(LED_COUNT, static_cast<uint16_t>(FRAME_US / 1000u))); },
+        nullptr, verify_animation},
+    {"program_rainbow", [] { host::upload_program(host::RAINBOW_PROGRAM); }, nullptr, verify_rainbow},
+    {"program_chase", [] { host::upload_program(host::CHASE_PROGRAM); }, nullptr, verify_chase_dot},
+    {"layer_add",
+        [] {
+            set_mode(firmware::EFFECT_MODE_RAINBOW);
+            set_layer(firmware::EFFECT_MODE_CHASE, firmware::BLEND_ADD);
+        },
+        nullptr, verify_layer_outside},
+    {"layer_multiply",
+        [] {
+            set_mode(firmware::EFFECT_MODE_RAINBOW);
+            set_layer(firmware::EFFECT_MODE_BREATHING, firmware::BLEND_MULTIPLY);
+        },
+        nullptr, verify_layer_outside},
+    {"layer_max",
+        [] {
+            set_mode(firmware::EFFECT_MODE_RAINBOW);
+            set_layer(firmware::EFFECT_MODE_COLOR_CYCLE, firmware::BLEND_MAX);
+        },
+        nullptr, verify_layer_outside},
+    {"layer_alpha",
+        [] {
+            set_mode(firmware::EFFECT_MODE_BREATHING);
+            set_layer(firmware::EFFECT_MODE_RAINBOW, firmware::BLEND_ALPHA);
+        },
+        nullptr, verify_layer_alpha},
+    {"zones",
+        [] {
+            set_mode(firmware::EFFECT_MODE_RAINBOW);
+            constexpr uint8_t HALF = LED_COUNT / 2;
+            const uint8_t fans[13] = {0, firmware::EFFECT_MODE_CHASE, 0, 0, HALF, 0,
+                firmware::ZONE_REVERSE | firmware::ZONE_OWN_COLOR, 3, 2, 0, 64, 255, firmware::ZONE_SPEED_GLOBAL};
+            protocol_execute(firmware::CMD_SET_ZONE, fans, sizeof(fans));
+            const uint8_t strip[13] = {1, firmware::EFFECT_MODE_BREATHING, HALF, 0, HALF, 0, 0, 1, 0, 0, 0, 0, 80};
+            protocol_execute(firmware::CMD_SET_ZONE, strip, sizeof(strip));
+        },
+        nullptr, verify_zones},
+    {"format_rgb",
+        [] {
+            setup_direct();
+            set_output_format(0, firmware::PIXEL_FORMAT_RGB);
+        },
+        feed_direct, verify_format_rgb},
+    {"format_brg",
+        [] {
+            setup_direct();
+            set_output_format(0, firmware::PIXEL_FORMAT_BRG);
+        },
+        feed_direct, verify_format_brg},
+    {"format_grbw",
+        [] {
+            setup_direct();
+            set_output_format(0, firmware::PIXEL_FORMAT_GRBW);
+        },
+        feed_direct, verify_format_grbw},
+    {"format_grb16",
+        [] {
+            setup_direct();
+            set_output_format(0, firmware::PIXEL_FORMAT_GRB16);
+        },
+        feed_direct, verify_format_grb16},
+    {"outputs_mixed",
+        [] {
+            // Output 0 drives the first 20 LEDs as GRB, output 1 the rest as GRBW. The
+            // base color is not saturated, so the white channel is lit.
+            set_mode(firmware::EFFECT_MODE_BREATHING);
+            const uint8_t first[5] = {0, 0, 0, 20, 0};
+            protocol_execute(firmware::CMD_SET_OUTPUT, first, sizeof(first));
+            set_output_format(1, firmware::PIXEL_FORMAT_GRBW);
+            const uint8_t second[5] = {1, 20, 0, LED_COUNT - 20, 0};
+            protocol_execute(firmware::CMD_SET_OUTPUT, second, sizeof(second));
+        },
+        nullptr, verify_outputs_mixed},
+    {"brightness_dither",
+        [] {
+            set_mode(firmware::EFFECT_MODE_RAINBOW);
+            const uint8_t brightness = 30;
+            protocol_execute(firmware::CMD_SET_BRIGHTNESS, &brightness, 1);
+            const uint8_t dither = 1;
+            protocol_execute(firmware::CMD_SET_DITHER, &dither, 1);
+        },
+        nullptr, verify_brightness_dither},
+    {"calibration",
+        [] {
+            set_mode(firmware::EFFECT_MODE_RAINBOW);
+            const uint8_t calibration[6] = {255, 224, 200, 22, 20, 24};
+            protocol_execute(firmware::CMD_SET_CALIBRATION, calibration, sizeof(calibration));
+        },
+        nullptr, verify_calibration},
+    {"power_limit",
+        [] {
+            set_mode(firmware::EFFECT_MODE_BREATHING);
+            // 10 mA per LED, below the peak of the breathing base color.
+            constexpr uint16_t BUDGET_MA = LED_COUNT * 10u;
+            const uint8_t limit[2] = {static_cast<uint8_t>(BUDGET_MA), static_cast<uint8_t>(BUDGET_MA >> 8)};
+            protocol_execute(firmware::CMD_SET_POWER_LIMIT, limit, sizeof(limit));
+        },
+        nullptr, verify_power_limit},
+};
+
+// FNV-1a-style fold of the hash of every frame sent, so a regression in any frame
+// shows up, not only in the last one.
+uint32_t render(const GoldenCase& golden)
+{
+    reset_firmware(LED_COUNT);
+    golden.setup();
+
+    uint32_t hash = 2166136261u;
+    uint32_t sent = host::mock_led_output_frame_count();
+    for (uint32_t frame = 0; frame < FRAMES; frame++) {
+        if (golden.feed != nullptr) {
+            golden.feed(frame);
+        }
+        host::advance_frame(FRAME_US);
+        if (host::mock_led_output_frame_count() != sent) {
+            sent = host::mock_led_output_frame_count();
+            hash = (hash ^ host::mock_led_output_hash()) * 16777619u;
+        }
+    }
+    return hash;
+}
+
+std::map<std::string, uint32_t> read_goldens(const char* path)
+{
+    std::map<std::string, uint32_t> goldens;
+    FILE* file = fopen(path, "r");
+    if (file == nullptr) {
+        return goldens;
+    }
+    char line[128];
+    while (fgets(line, sizeof(line), file) != nullptr) {
+        char name[64];
+        unsigned hash = 0;
+        if (line[0] != '#' && sscanf(line, "%63s %x", name, &hash) == 2) {
+            goldens[name] = hash;
+        }
+    }
+    fclose(file);
+    return goldens;
+}
+
+bool write_goldens(const char* path, const std::map<std::string, uint32_t>& hashes)
+{
+    FILE* file = fopen(path, "w");
+    if (file == nullptr) {
+        return false;
+    }
+    fprintf(file, "# Frame hashes checked by golden_test (%u LEDs, %u frames per case).\n", LED_COUNT, FRAMES);
+    fprintf(file, "# Regenerate with: picoargb_golden_test <this file> --update\n");
+    for (const GoldenCase& golden : CASES) {
+        fprintf(file, "%s %08x\n", golden.name, hashes.at(golden.name));
+    }
+    fclose(file);
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <golden file> [--update]\n", argv[0]);
+        return 2;
+    }
+    const char* path = argv[1];
+    const bool update = argc > 2 && strcmp(argv[2], "--update") == 0;
+
+    const std::map<std::string, uint32_t> goldens = read_goldens(path);
+    std::map<std::string, uint32_t> hashes;
+    int failures = 0;
+    for (const GoldenCase& golden : CASES) {
+        const uint32_t hash = render(golden);
+        hashes[golden.name] = hash;
+        const auto expected = goldens.find(golden.name);
+        const char* problem = golden.verify(host::mock_led_output_last_frame());
+        if (problem != nullptr) {
+            printf("%-18s %08x  %s\n", golden.name, hash, problem);
+            failures++;
+        } else if (expected == goldens.end()) {
+            printf("%-18s %08x  missing golden\n", golden.name, hash);
+            failures++;
+        } else if (expected->second != hash) {
+            printf("%-18s %08x  expected %08x\n", golden.name, hash, expected->second);
+            failures++;
+        } else {
+            printf("%-18s %08x  ok\n", golden.name, hash);
+        }
+    }
+
+    if (update) {
+        if (!write_goldens(path, hashes)) {
+            fprintf(stderr, "cannot write %s\n", path);
+            return 2;
+        }
+        printf("goldens written to %s\n", path);
+        return 0;
+    }
+    if (failures != 0) {
+        printf("%d of %zu cases differ from the goldens\n", failures, sizeof(CASES) / sizeof(CASES[0]));
+        return 1;
+    }
+    return 0;
+}
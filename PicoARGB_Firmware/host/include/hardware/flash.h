@@ -0,0 +1,16 @@
+#pragma once
+
+// Host stand-in for the SDK header, backed by the RAM image in fake_flash.cpp.
+// Programming only clears bits, as on NOR flash.
+#include <stddef.h>
+#include <stdint.h>
+
+#define FLASH_PAGE_SIZE (1u << 8)
+#define FLASH_SECTOR_SIZE (1u << 12)
+#define PICO_FLASH_SIZE_BYTES (2u * 1024u * 1024u)
+
+extern uint8_t host_flash_image[PICO_FLASH_SIZE_BYTES];
+#define XIP_BASE (reinterpret_cast<uintptr_t>(host_flash_image))
+
+void flash_range_erase(uint32_t flash_offs, size_t count);
+void flash_range_program(uint32_t flash_offs, const uint8_t* data, size_t count);
@@ -0,0 +1,18 @@
+#pragma once
+
+// Host stand-in for the SDK header. The host build is single threaded, so the
+// interrupt masks and barriers only need to compile.
+#include <stdint.h>
+
+static inline uint32_t save_and_disable_interrupts()
+{
+    return 0;
+}
+
+static inline void restore_interrupts(uint32_t) {}
+static inline void __dmb() {}
+static inline void __mem_fence_release() {}
+static inline void __mem_fence_acquire() {}
+static inline void __compiler_memory_barrier() {}
+static inline void __sev() {}
+static inline void __wfe() {}
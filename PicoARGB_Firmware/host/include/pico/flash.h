@@ -0,0 +1,9 @@
+#pragma once
+
+// Host stand-in for the SDK header; there is no second core to lock out.
+#include <stdint.h>
+
+#define PICO_OK 0
+
+int flash_safe_execute(void (*func)(void*), void* param, uint32_t enter_exit_timeout_ms);
+bool flash_safe_execute_core_init();
@@ -0,0 +1,32 @@
+#pragma once
+
+// Host stand-in for the SDK header: only what the portable firmware sources use.
+#include <stdint.h>
+#include <stddef.h>
+
+typedef unsigned int uint;
+typedef uint64_t absolute_time_t;
+
+// Backed by the fake clock in fake_clock.cpp.
+absolute_time_t get_absolute_time();
+uint32_t time_us_32();
+uint64_t time_us_64();
+
+static inline uint32_t to_ms_since_boot(absolute_time_t t)
+{
+    return static_cast<uint32_t>(t / 1000u);
+}
+
+static inline uint64_t to_us_since_boot(absolute_time_t t)
+{
+    return t;
+}
+
+static inline void tight_loop_contents() {}
+
+#define GPIO_OUT 1
+static inline void gpio_init(uint) {}
+static inline void gpio_set_dir(uint, bool) {}
+static inline void gpio_put(uint, bool) {}
+
+#include "hardware/sync.h"
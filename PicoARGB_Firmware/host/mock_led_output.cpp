@@ -0,0 +1,90 @@
+#include "mock_led_output.h"
+
+#include "config.h"
+#include "led_output.h"
+
+namespace host {
+namespace {
+
+uint32_t frame_buffers[2][firmware::FRAME_WORDS] = {};
+firmware::OutputSpan frame_spans[2][firmware::MAX_OUTPUT_CHANNELS] = {};
+// Words up to the end of the furthest span of the last frame.
+uint16_t frame_length = 0;
+uint8_t front_index = 0;
+uint32_t frame_count = 0;
+
+} // namespace
+
+RecordedFrame mock_led_output_last_frame()
+{
+    return {frame_buffers[front_index], frame_length};
+}
+
+uint32_t mock_led_output_frame_count()
+{
+    return frame_count;
+}
+
+// FNV-1a over the words of the last frame, so a whole frame compares as one value.
+uint32_t mock_led_output_hash()
+{
+    uint32_t hash = 2166136261u;
+    const uint32_t* words = frame_buffers[front_index];
+    for (uint16_t i = 0; i < frame_length; i++) {
+        for (uint32_t shift = 0; shift < 32; shift += 8) {
+            hash ^= (words[i] >> shift) & 0xFFu;
+            hash *= 16777619u;
+        }
+    }
+    return hash;
+}
+
+} // namespace host
+
+namespace firmware {
+
+void led_output_init()
+{
+    host::frame_length = 0;
+    host::front_index = 0;
+    host::frame_count = 0;
+}
+
+bool led_output_configure(uint8_t index, uint8_t bits_per_word)
+{
+    return index < MAX_OUTPUT_CHANNELS && (bits_per_word == 24 || bits_per_word == 32);
+}
+
+uint32_t* led_output_begin_frame()
+{
+    return host::frame_buffers[host::front_index ^ 1u];
+}
+
+void led_output_submit(const OutputSpan* spans)
+{
+    host::front_index ^= 1u;
+    host::frame_length = 0;
+    for (uint8_t i = 0; i < MAX_OUTPUT_CHANNELS; i++) {
+        host::frame_spans[host::front_index][i] = spans[i];
+        const uint16_t end = static_cast<uint16_t>(spans[i].offset + spans[i].count);
+        if (spans[i].count != 0 && end > host::frame_length) {
+            host::frame_length = end;
+        }
+    }
+    host::frame_count++;
+}
+
+const uint32_t* led_output_last_frame(const OutputSpan*& spans)
+{
+    spans = host::frame_spans[host::front_index];
+    return host::frame_buffers[host::front_index];
+}
+
+bool led_output_busy()
+{
+    return false;
+}
+
+void led_output_clock_changed() {}
+
+} // namespace firmware
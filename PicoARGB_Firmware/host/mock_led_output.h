@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stdint.h>
+
+namespace host {
+
+// Last frame handed to led_output_submit(), as the packed words the PIO would have
+// shifted out, up to the end of its furthest output span. Transfers complete
+// immediately, so the output is never busy.
+struct RecordedFrame {
+    const uint32_t* words;
+    uint16_t length;
+};
+
+RecordedFrame mock_led_output_last_frame();
+uint32_t mock_led_output_frame_count();
+uint32_t mock_led_output_hash();
+
+} // namespace host
@@ -0,0 +1,173 @@
+#include "check.h"
+#include "config.h"
+#include "effects.h"
+#include "led_driver.h"
+#include "mock_led_output.h"
+#include "pixel_format.h"
+#include "protocol.h"
+#include "scenario.h"
+
+// Behaviour of the output stage: which frames led_show() actually submits, the
+// keep-alive refresh, and re-sending a static frame after an output setting changes.
+namespace {
+
+using firmware::protocol_execute;
+using host::advance_frame;
+using host::mock_led_output_frame_count;
+
+constexpr uint16_t LED_COUNT = 60;
+constexpr uint32_t FRAME_US = 1000000u / firmware::DEFAULT_FRAME_RATE;
+
+// Static mode with its first frame already sent.
+void start_static()
+{
+    host::reset_firmware(LED_COUNT);
+    host::set_mode(firmware::EFFECT_MODE_STATIC);
+    advance_frame(FRAME_US);
+}
+
+uint32_t frames_sent_over(uint32_t frames)
+{
+    const uint32_t before = mock_led_output_frame_count();
+    for (uint32_t i = 0; i < frames; i++) {
+        advance_frame(FRAME_US);
+    }
+    return mock_led_output_frame_count() - before;
+}
+
+uint32_t first_word()
+{
+    return host::mock_led_output_last_frame().words[0];
+}
+
+void test_static_frame_is_skipped()
+{
+    start_static();
+    CHECK_EQ(frames_sent_over(30), 0);
+    CHECK(firmware::effects_idle());
+}
+
+void test_animated_frames_are_sent()
+{
+    host::reset_firmware(LED_COUNT);
+    host::set_mode(firmware::EFFECT_MODE_RAINBOW);
+    CHECK_EQ(frames_sent_over(30), 30);
+    CHECK(!firmware::effects_idle());
+}
+
+void test_keepalive_resends_static_frame()
+{
+    start_static();
+    const uint32_t frames_per_keepalive = (firmware::LED_KEEPALIVE_MS * 1000u) / FRAME_US;
+    CHECK_EQ(frames_sent_over(frames_per_keepalive - 1), 0);
+    // Exactly one refresh once the keep-alive period has passed.
+    CHECK_EQ(frames_sent_over(3), 1);
+}
+
+void test_calibration_change_resends_static_frame()
+{
+    start_static();
+    const uint32_t lit = first_word();
+    firmware::led_set_calibration({{255, 0, 0}, {20, 20, 20}});
+    CHECK(firmware::led_output_dirty());
+    CHECK(!firmware::effects_idle());
+    CHECK_EQ(frames_sent_over(1), 1);
+    CHECK(first_word() != lit);
+    // Only red is left, in the second byte of a GRB word.
+    CHECK_EQ(first_word() & 0xFF00FF00u, 0);
+    CHECK(!firmware::led_output_dirty());
+    CHECK_EQ(frames_sent_over(10), 0);
+}
+
+void test_calibration_command_shows_at_once()
+{
+    start_static();
+    const uint32_t before = mock_led_output_frame_count();
+    const uint8_t red_only[6] = {255, 0, 0, 20, 20, 20};
+    protocol_execute(firmware::CMD_SET_CALIBRATION, red_only, sizeof(red_only));
+    CHECK_EQ(mock_led_output_frame_count(), before + 1);
+    CHECK_EQ(first_word() & 0xFF00FF00u, 0);
+
+    // A rejected calibration (gamma out of range) leaves the output alone.
+    const uint8_t bad_gamma[6] = {255, 255, 255, 9, 20, 20};
+    protocol_execute(firmware::CMD_SET_CALIBRATION, bad_gamma, sizeof(bad_gamma));
+    CHECK_EQ(mock_led_output_frame_count(), before + 1);
+}
+
+void test_format_change_resends_static_frame()
+{
+    start_static();
+    const uint32_t grb = first_word();
+    firmware::led_set_output_format(0, firmware::PIXEL_FORMAT_RGB);
+    CHECK_EQ(frames_sent_over(1), 1);
+    // Same channels with the first two bytes swapped.
+    CHECK_EQ(first_word(), ((grb & 0xFF000000u) >> 8) | ((grb & 0x00FF0000u) << 8) | (grb & 0xFFu << 8));
+    CHECK_EQ(frames_sent_over(10), 0);
+}
+
+void test_format_command_shows_at_once()
+{
+    start_static();
+    const uint32_t grb = first_word();
+    const uint32_t before = mock_led_output_frame_count();
+    const uint8_t grbw[2] = {0, firmware::PIXEL_FORMAT_GRBW};
+    protocol_execute(firmware::CMD_SET_OUTPUT_FORMAT, grbw, sizeof(grbw));
+    CHECK_EQ(mock_led_output_frame_count(), before + 1);
+    CHECK(first_word() != grb);
+
+    const uint8_t unknown[2] = {0, firmware::PIXEL_FORMAT_COUNT};
+    protocol_execute(firmware::CMD_SET_OUTPUT_FORMAT, unknown, sizeof(unknown));
+    CHECK_EQ(mock_led_output_frame_count(), before + 1);
+}
+
+void test_dither_resends_static_frame_every_tick()
+{
+    start_static();
+    const uint8_t on = 1;
+    protocol_execute(firmware::CMD_SET_DITHER, &on, 1);
+    CHECK_EQ(frames_sent_over(30), 30);
+    // The frame scheduler must not drop to the idle period while dithering.
+    CHECK(!firmware::effects_idle());
+
+    const uint8_t off = 0;
+    protocol_execute(firmware::CMD_SET_DITHER, &off, 1);
+    // At most one frame with the plain rounding, then static frames are skipped again.
+    CHECK(frames_sent_over(30) <= 1);
+    CHECK(firmware::effects_idle());
+}
+
+void test_dither_resends_off_frame_every_tick()
+{
+    start_static();
+    host::set_mode(firmware::EFFECT_MODE_OFF);
+    const uint8_t on = 1;
+    protocol_execute(firmware::CMD_SET_DITHER, &on, 1);
+    CHECK_EQ(frames_sent_over(30), 30);
+    CHECK(!firmware::effects_idle());
+}
+
+void test_unchanged_setting_does_not_resend()
+{
+    start_static();
+    firmware::led_set_output_format(0, firmware::PIXEL_FORMAT_GRB);
+    firmware::led_set_brightness(firmware::DEFAULT_BRIGHTNESS);
+    CHECK(!firmware::led_output_dirty());
+    CHECK_EQ(frames_sent_over(10), 0);
+}
+
+} // namespace
+
+int main()
+{
+    RUN_TEST(test_static_frame_is_skipped);
+    RUN_TEST(test_animated_frames_are_sent);
+    RUN_TEST(test_keepalive_resends_static_frame);
+    RUN_TEST(test_calibration_change_resends_static_frame);
+    RUN_TEST(test_calibration_command_shows_at_once);
+    RUN_TEST(test_format_change_resends_static_frame);
+    RUN_TEST(test_format_command_shows_at_once);
+    RUN_TEST(test_dither_resends_static_frame_every_tick);
+    RUN_TEST(test_dither_resends_off_frame_every_tick);
+    RUN_TEST(test_unchanged_setting_does_not_resend);
+    return host::checks_passed() ? 0 : 1;
+}
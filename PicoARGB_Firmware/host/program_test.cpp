@@ -0,0 +1,129 @@
+#include <initializer_list>
+#include <vector>
+
+#include "check.h"
+#include "led_driver.h"
+#include "pixel_program.h"
+#include "scenario.h"
+
+// The pixel program VM: load-time validation of skips, registers and opcodes, and
+// the channel round trip through its Q16 registers.
+namespace {
+
+using firmware::PROGRAM_OP_ADD;
+using firmware::PROGRAM_OP_HUE;
+using firmware::PROGRAM_OP_MOV;
+using firmware::PROGRAM_OP_SKIP_GE;
+using firmware::PROGRAM_OP_SKIP_LT;
+using firmware::PROGRAM_REG_COLOR;
+using firmware::PROGRAM_REG_OUT;
+using firmware::PROGRAM_REGISTERS;
+using host::ProgramInstruction;
+
+constexpr uint16_t LED_COUNT = 8;
+constexpr firmware::Rgb BASE_COLOR = {255, 96, 16};
+
+bool load(const std::vector<ProgramInstruction>& program)
+{
+    const uint8_t* code = reinterpret_cast<const uint8_t*>(program.data());
+    const uint16_t size = static_cast<uint16_t>(program.size() * sizeof(ProgramInstruction));
+    return firmware::program_write(0, code, size) && firmware::program_load(size);
+}
+
+// Renders LED_COUNT pixels over the base color.
+std::vector<firmware::Rgb> render()
+{
+    std::vector<firmware::Rgb> pixels(LED_COUNT);
+    firmware::program_render({0, 0, BASE_COLOR}, {pixels.data(), LED_COUNT});
+    return pixels;
+}
+
+// Copies the base color to the output.
+const std::vector<ProgramInstruction> COPY_COLOR = {
+    {PROGRAM_OP_MOV, PROGRAM_REG_OUT, PROGRAM_REG_COLOR, 0},
+    {PROGRAM_OP_MOV, PROGRAM_REG_OUT + 1, PROGRAM_REG_COLOR + 1, 0},
+    {PROGRAM_OP_MOV, PROGRAM_REG_OUT + 2, PROGRAM_REG_COLOR + 2, 0},
+};
+
+bool is_base_color(firmware::Rgb pixel)
+{
+    return pixel.r == BASE_COLOR.r && pixel.g == BASE_COLOR.g && pixel.b == BASE_COLOR.b;
+}
+
+void test_channels_round_trip()
+{
+    CHECK(load(COPY_COLOR));
+    for (const firmware::Rgb& pixel : render()) {
+        CHECK(is_base_color(pixel));
+    }
+
+    // A full-scale hue keeps a full-scale channel.
+    CHECK(load({{PROGRAM_OP_HUE, PROGRAM_REG_OUT, 0, 0}}));
+    CHECK_EQ(render()[0].r, 255);
+}
+
+void test_skip_past_end_is_rejected()
+{
+    // Skipping to exactly the end is allowed and leaves the pixel black.
+    std::vector<ProgramInstruction> program = {{PROGRAM_OP_SKIP_GE, 3, 0, 0}};
+    program.insert(program.end(), COPY_COLOR.begin(), COPY_COLOR.end());
+    CHECK(load(program));
+    CHECK_EQ(render()[0].r, 0);
+
+    // One further lands past the last instruction.
+    program[0].dst = 4;
+    CHECK(!load(program));
+    // Counts are unsigned, so there are no backward jumps; the largest one would
+    // wrap an 8-bit program counter.
+    program[0].dst = 0xFF;
+    CHECK(!load(program));
+    CHECK(!load({{PROGRAM_OP_SKIP_LT, 1, 0, 0}}));
+}
+
+void test_skip_operands_are_checked()
+{
+    CHECK(!load({{PROGRAM_OP_SKIP_LT, 0, PROGRAM_REGISTERS, 0}, COPY_COLOR[0]}));
+    CHECK(!load({{PROGRAM_OP_SKIP_GE, 0, 0, PROGRAM_REGISTERS}, COPY_COLOR[0]}));
+}
+
+void test_register_out_of_range_is_rejected()
+{
+    CHECK(!load({{PROGRAM_OP_ADD, PROGRAM_REGISTERS, 0, 0}}));
+    CHECK(!load({{PROGRAM_OP_ADD, 0, PROGRAM_REGISTERS, 0}}));
+    CHECK(!load({{PROGRAM_OP_ADD, 0, 0, 0xFF}}));
+    CHECK(!load({host::program_load(PROGRAM_REGISTERS, 1.0)}));
+    // HUE writes three registers, so the last two cannot take it.
+    CHECK(load({{PROGRAM_OP_HUE, PROGRAM_REGISTERS - 3, 0, 0}}));
+    CHECK(!load({{PROGRAM_OP_HUE, PROGRAM_REGISTERS - 2, 0, 0}}));
+}
+
+void test_malformed_program_is_rejected()
+{
+    CHECK(!load({{firmware::PROGRAM_OP_COUNT, 0, 0, 0}}));
+    CHECK(!firmware::program_load(0));
+    CHECK(!firmware::program_load(6));
+    const std::vector<ProgramInstruction> too_long(firmware::MAX_PROGRAM_INSTRUCTIONS + 1u, COPY_COLOR[0]);
+    CHECK(!load(too_long));
+    const std::vector<ProgramInstruction> longest(firmware::MAX_PROGRAM_INSTRUCTIONS, COPY_COLOR[0]);
+    CHECK(load(longest));
+}
+
+void test_rejected_load_keeps_running_program()
+{
+    CHECK(load(COPY_COLOR));
+    CHECK(!load({COPY_COLOR[0], {PROGRAM_OP_SKIP_GE, 5, 0, 0}}));
+    CHECK(is_base_color(render()[LED_COUNT - 1]));
+}
+
+} // namespace
+
+int main()
+{
+    RUN_TEST(test_channels_round_trip);
+    RUN_TEST(test_skip_past_end_is_rejected);
+    RUN_TEST(test_skip_operands_are_checked);
+    RUN_TEST(test_register_out_of_range_is_rejected);
+    RUN_TEST(test_malformed_program_is_rejected);
+    RUN_TEST(test_rejected_load_keeps_running_program);
+    return host::checks_passed() ? 0 : 1;
+}
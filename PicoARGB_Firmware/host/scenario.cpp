@@ -0,0 +1,152 @@
+#include "scenario.h"
+
+#include <string.h>
+
+#include "animation.h"
+#include "config.h"
+#include "crc32.h"
+#include "effects.h"
+#include "fake_clock.h"
+#include "pixel_format.h"
+#include "protocol.h"
+
+namespace host {
+
+using firmware::protocol_execute;
+
+void reset_firmware(uint16_t led_count)
+{
+    fake_clock_set_us(1000000);
+    firmware::led_driver_init();
+    firmware::effects_init();
+
+    // Driver state outlives led_driver_init(), as it does across USB reconnects.
+    for (uint8_t output = 0; output < firmware::MAX_OUTPUT_CHANNELS; output++) {
+        const uint8_t format[2] = {output, firmware::PIXEL_FORMAT_GRB};
+        protocol_execute(firmware::CMD_SET_OUTPUT_FORMAT, format, sizeof(format));
+        if (output != 0) {
+            const uint8_t unmapped[5] = {output, 0, 0, 0, 0};
+            protocol_execute(firmware::CMD_SET_OUTPUT, unmapped, sizeof(unmapped));
+        }
+    }
+    const uint8_t brightness = firmware::DEFAULT_BRIGHTNESS;
+    protocol_execute(firmware::CMD_SET_BRIGHTNESS, &brightness, 1);
+    const uint8_t dither = 0;
+    protocol_execute(firmware::CMD_SET_DITHER, &dither, 1);
+    const uint8_t calibration[6] = {255, 255, 255, firmware::DEFAULT_GAMMA_TENTHS, firmware::DEFAULT_GAMMA_TENTHS,
+        firmware::DEFAULT_GAMMA_TENTHS};
+    protocol_execute(firmware::CMD_SET_CALIBRATION, calibration, sizeof(calibration));
+    const uint8_t power[6] = {0, 0, firmware::DEFAULT_CHANNEL_MA, firmware::DEFAULT_CHANNEL_MA,
+        firmware::DEFAULT_CHANNEL_MA, firmware::DEFAULT_IDLE_TENTHS_MA};
+    protocol_execute(firmware::CMD_SET_POWER_LIMIT, power, sizeof(power));
+
+    const uint8_t count[2] = {static_cast<uint8_t>(led_count), static_cast<uint8_t>(led_count >> 8)};
+    protocol_execute(firmware::CMD_SET_LED_COUNT, count, sizeof(count));
+    const uint8_t color[3] = {255, 96, 16};
+    protocol_execute(firmware::CMD_SET_COLOR, color, sizeof(color));
+}
+
+void set_mode(uint8_t mode)
+{
+    protocol_execute(firmware::CMD_SET_MODE, &mode, 1);
+}
+
+void advance_frame(uint32_t frame_us)
+{
+    fake_clock_advance_us(frame_us);
+    firmware::effects_update(to_ms_since_boot(get_absolute_time()));
+}
+
+std::vector<uint8_t> build_animation(uint16_t led_count, uint16_t frame_ms, uint8_t flags)
+{
+    const firmware::AnimationHeader header = {{firmware::ANIMATION_MAGIC[0], firmware::ANIMATION_MAGIC[1]},
+        firmware::ANIMATION_VERSION, flags, frame_ms, led_count, ANIMATION_FRAMES, 0};
+    std::vector<uint8_t> image(reinterpret_cast<const uint8_t*>(&header),
+        reinterpret_cast<const uint8_t*>(&header) + sizeof(header));
+
+    const auto frame = [&image](uint8_t type, const std::vector<uint8_t>& data) {
+        image.push_back(type);
+        image.push_back(static_cast<uint8_t>(data.size()));
+        image.push_back(static_cast<uint8_t>(data.size() >> 8));
+        image.insert(image.end(), data.begin(), data.end());
+    };
+
+    std::vector<uint8_t> keyframe;
+    for (uint16_t left = led_count; left > 0;) {
+        const uint8_t run = static_cast<uint8_t>((left < 255) ? left : 255);
+        const uint8_t shade = static_cast<uint8_t>(keyframe.size() * 8u);
+        keyframe.insert(keyframe.end(), {run, 0, shade, 64});
+        left = static_cast<uint16_t>(left - run);
+    }
+    frame(firmware::ANIMATION_FRAME_RLE, keyframe);
+    for (uint16_t i = 1; i < ANIMATION_FRAMES; i++) {
+        const uint16_t dot = static_cast<uint16_t>(i % led_count);
+        std::vector<uint8_t> delta;
+        for (uint16_t skip = dot; skip > 255; skip = static_cast<uint16_t>(skip - 255)) {
+            delta.insert(delta.end(), {255, 0});
+        }
+        delta.insert(delta.end(), {static_cast<uint8_t>(dot % 255), 1, 255, 255, 255});
+        frame(firmware::ANIMATION_FRAME_DELTA, delta);
+    }
+    return image;
+}
+
+void upload_animation(const std::vector<uint8_t>& image)
+{
+    const uint32_t size = static_cast<uint32_t>(image.size());
+    const uint8_t begin[5] = {firmware::ANIMATION_TARGET_RAM, static_cast<uint8_t>(size),
+        static_cast<uint8_t>(size >> 8), static_cast<uint8_t>(size >> 16), static_cast<uint8_t>(size >> 24)};
+    protocol_execute(firmware::CMD_ANIMATION_BEGIN, begin, sizeof(begin));
+
+    constexpr uint32_t CHUNK_BYTES = 59;
+    uint8_t chunk[4 + CHUNK_BYTES];
+    for (uint32_t offset = 0; offset < size; offset += CHUNK_BYTES) {
+        const uint32_t count = (size - offset < CHUNK_BYTES) ? size - offset : CHUNK_BYTES;
+        for (uint32_t i = 0; i < 4; i++) {
+            chunk[i] = static_cast<uint8_t>(offset >> (i * 8));
+        }
+        memcpy(&chunk[4], &image[offset], count);
+        protocol_execute(firmware::CMD_ANIMATION_DATA, chunk, static_cast<uint16_t>(4 + count));
+    }
+    const uint32_t crc = firmware::crc32(image.data(), size);
+    const uint8_t end[4] = {static_cast<uint8_t>(crc), static_cast<uint8_t>(crc >> 8), static_cast<uint8_t>(crc >> 16),
+        static_cast<uint8_t>(crc >> 24)};
+    protocol_execute(firmware::CMD_ANIMATION_END, end, sizeof(end));
+}
+
+void upload_program(const ProgramInstruction* program, size_t count)
+{
+    const uint8_t* code = reinterpret_cast<const uint8_t*>(program);
+    const uint16_t size = static_cast<uint16_t>(count * sizeof(ProgramInstruction));
+    constexpr uint16_t CHUNK_BYTES = 60;
+    uint8_t chunk[2 + CHUNK_BYTES];
+    for (uint16_t offset = 0; offset < size; offset = static_cast<uint16_t>(offset + CHUNK_BYTES)) {
+        const uint16_t bytes = (size - offset < CHUNK_BYTES) ? size - offset : CHUNK_BYTES;
+        chunk[0] = static_cast<uint8_t>(offset);
+        chunk[1] = static_cast<uint8_t>(offset >> 8);
+        memcpy(&chunk[2], &code[offset], bytes);
+        protocol_execute(firmware::CMD_PROGRAM_DATA, chunk, static_cast<uint16_t>(2 + bytes));
+    }
+    const uint8_t load_size[2] = {static_cast<uint8_t>(size), static_cast<uint8_t>(size >> 8)};
+    protocol_execute(firmware::CMD_PROGRAM_LOAD, load_size, sizeof(load_size));
+}
+
+void send_direct_frame(uint16_t led_count, uint32_t seed)
+{
+    constexpr uint8_t CHUNK_PIXELS = 20;
+    uint8_t payload[3 + CHUNK_PIXELS * 3] = {};
+    for (uint16_t offset = 0; offset < led_count; offset += CHUNK_PIXELS) {
+        const uint16_t remaining = led_count - offset;
+        const uint8_t count = (remaining < CHUNK_PIXELS) ? remaining : CHUNK_PIXELS;
+        payload[0] = static_cast<uint8_t>(offset);
+        payload[1] = static_cast<uint8_t>(offset >> 8);
+        payload[2] = count;
+        for (uint32_t i = 0; i < count * 3u; i++) {
+            payload[3 + i] = static_cast<uint8_t>(seed + offset + i);
+        }
+        protocol_execute(firmware::CMD_DIRECT_PIXELS, payload, static_cast<uint16_t>(3 + count * 3));
+    }
+    protocol_execute(firmware::CMD_DIRECT_COMMIT, nullptr, 0);
+}
+
+} // namespace host
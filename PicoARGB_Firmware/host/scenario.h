@@ -0,0 +1,87 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include "animation.h"
+#include "pixel_program.h"
+
+// Firmware setups shared by the benchmark and the golden-frame test. Everything goes
+// through protocol_execute(), as commands from the render core's queue would.
+namespace host {
+
+// Boots the firmware at a fixed time with `led_count` LEDs, one GRB output and
+// default brightness, calibration and power limit, plus the base color used by
+// every scenario.
+void reset_firmware(uint16_t led_count);
+void set_mode(uint8_t mode);
+
+// Advances the fake clock by one frame period and lets the render core run.
+void advance_frame(uint32_t frame_us);
+
+// A dot over a two-color RLE keyframe: every frame is a delta that moves it one LED.
+// Loops unless `flags` says otherwise. Uploaded to RAM in HID-sized chunks, which
+// starts playback.
+constexpr uint16_t ANIMATION_FRAMES = 60;
+std::vector<uint8_t> build_animation(uint16_t led_count, uint16_t frame_ms,
+    uint8_t flags = firmware::ANIMATION_LOOP);
+void upload_animation(const std::vector<uint8_t>& image);
+
+struct ProgramInstruction {
+    uint8_t op;
+    uint8_t dst;
+    uint8_t a;
+    uint8_t b;
+};
+
+// Q8.8 immediate for PROGRAM_OP_LOAD.
+constexpr ProgramInstruction program_load(uint8_t dst, double value)
+{
+    const int16_t fixed = static_cast<int16_t>(value * 256.0 + (value < 0.0 ? -0.5 : 0.5));
+    return {firmware::PROGRAM_OP_LOAD, dst, static_cast<uint8_t>(fixed), static_cast<uint8_t>(fixed >> 8)};
+}
+
+// The native rainbow: hue = position + time * 0.125 turns.
+constexpr ProgramInstruction RAINBOW_PROGRAM[] = {
+    program_load(11, 0.125),
+    {firmware::PROGRAM_OP_MUL, 11, firmware::PROGRAM_REG_TIME, 11},
+    {firmware::PROGRAM_OP_ADD, 11, 11, firmware::PROGRAM_REG_POSITION},
+    {firmware::PROGRAM_OP_HUE, firmware::PROGRAM_REG_OUT, 11, 0},
+};
+
+// A chase: the base color fades out over 2.5 LEDs around a head moving 0.1 turns/s.
+constexpr ProgramInstruction CHASE_PROGRAM[] = {
+    program_load(11, 0.1),
+    {firmware::PROGRAM_OP_MUL, 11, firmware::PROGRAM_REG_TIME, 11},
+    {firmware::PROGRAM_OP_SUB, 11, firmware::PROGRAM_REG_POSITION, 11},
+    program_load(12, 0.5),
+    {firmware::PROGRAM_OP_ADD, 11, 11, 12},
+    {firmware::PROGRAM_OP_FRAC, 11, 11, 0},
+    {firmware::PROGRAM_OP_SUB, 11, 11, 12},
+    {firmware::PROGRAM_OP_ABS, 11, 11, 0},
+    {firmware::PROGRAM_OP_MUL, 11, 11, firmware::PROGRAM_REG_COUNT},
+    program_load(12, 2.5),
+    // Pixels further than 2.5 LEDs skip the fade and stay black.
+    {firmware::PROGRAM_OP_SKIP_GE, 5, 11, 12},
+    {firmware::PROGRAM_OP_SUB, 11, 12, 11},
+    {firmware::PROGRAM_OP_DIV, 11, 11, 12},
+    {firmware::PROGRAM_OP_MUL, firmware::PROGRAM_REG_OUT, firmware::PROGRAM_REG_COLOR, 11},
+    {firmware::PROGRAM_OP_MUL, firmware::PROGRAM_REG_OUT + 1, firmware::PROGRAM_REG_COLOR + 1, 11},
+    {firmware::PROGRAM_OP_MUL, firmware::PROGRAM_REG_OUT + 2, firmware::PROGRAM_REG_COLOR + 2, 11},
+};
+
+// Uploads a program over HID-sized PROGRAM_DATA chunks and loads it.
+void upload_program(const ProgramInstruction* program, size_t count);
+
+template <size_t N>
+void upload_program(const ProgramInstruction (&program)[N])
+{
+    upload_program(program, N);
+}
+
+// Sends one host-rendered frame as HID-sized DIRECT_PIXELS chunks, then commits it.
+// Channel values are a ramp seeded by `seed`, so consecutive frames differ.
+void send_direct_frame(uint16_t led_count, uint32_t seed);
+
+} // namespace host
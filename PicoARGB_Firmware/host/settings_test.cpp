@@ -0,0 +1,176 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "check.h"
+#include "config.h"
+#include "crc32.h"
+#include "hardware/flash.h"
+#include "led_driver.h"
+#include "protocol.h"
+#include "scenario.h"
+#include "settings.h"
+
+// The settings log in flash: records are written once the state settles, a full
+// sector is compacted into the other one, and a record whose CRC does not match is
+// ignored on load.
+namespace {
+
+using firmware::protocol_execute;
+
+constexpr uint16_t LED_COUNT = 60;
+constexpr uint32_t CHECK_MS = 100;
+// Matches settings.cpp: 64-byte records, the sequence first and the CRC last.
+constexpr uint32_t RECORD_BYTES = 64;
+constexpr uint32_t RECORDS_PER_SECTOR = FLASH_SECTOR_SIZE / RECORD_BYTES;
+constexpr uint32_t SECTORS = firmware::SETTINGS_FLASH_BYTES / FLASH_SECTOR_SIZE;
+constexpr uint32_t LOG_OFFSET = PICO_FLASH_SIZE_BYTES - firmware::SETTINGS_FLASH_BYTES;
+constexpr uint32_t EMPTY_SEQUENCE = 0xFFFFFFFFu;
+
+uint32_t now_ms = 0;
+
+uint8_t* record_at(uint32_t sector, uint32_t slot)
+{
+    return &host_flash_image[LOG_OFFSET + (sector * FLASH_SECTOR_SIZE) + (slot * RECORD_BYTES)];
+}
+
+uint32_t sequence_of(const uint8_t* record)
+{
+    uint32_t sequence = 0;
+    memcpy(&sequence, record, sizeof(sequence));
+    return sequence;
+}
+
+bool record_valid(const uint8_t* record)
+{
+    uint32_t crc = 0;
+    memcpy(&crc, record + RECORD_BYTES - sizeof(crc), sizeof(crc));
+    return sequence_of(record) != EMPTY_SEQUENCE && crc == firmware::crc32(record, RECORD_BYTES - sizeof(crc));
+}
+
+uint32_t valid_records(uint32_t sector)
+{
+    uint32_t count = 0;
+    for (uint32_t slot = 0; slot < RECORDS_PER_SECTOR; slot++) {
+        count += record_valid(record_at(sector, slot)) ? 1 : 0;
+    }
+    return count;
+}
+
+uint8_t* newest_record()
+{
+    uint8_t* newest = nullptr;
+    for (uint32_t sector = 0; sector < SECTORS; sector++) {
+        for (uint32_t slot = 0; slot < RECORDS_PER_SECTOR; slot++) {
+            uint8_t* record = record_at(sector, slot);
+            if (record_valid(record) && (newest == nullptr || sequence_of(record) > sequence_of(newest))) {
+                newest = record;
+            }
+        }
+    }
+    return newest;
+}
+
+// Boots on a blank chip.
+void boot_blank()
+{
+    memset(&host_flash_image[LOG_OFFSET], 0xFF, firmware::SETTINGS_FLASH_BYTES);
+    host::reset_firmware(LED_COUNT);
+    firmware::settings_load();
+}
+
+// Reboots on the flash as it is.
+void reboot()
+{
+    host::reset_firmware(LED_COUNT);
+    firmware::settings_load();
+}
+
+// Sets the brightness and services the log until it has been stable long enough to
+// be written.
+void persist_brightness(uint8_t brightness)
+{
+    protocol_execute(firmware::CMD_SET_BRIGHTNESS, &brightness, 1);
+    for (uint32_t elapsed = 0; elapsed <= firmware::SETTINGS_WRITE_DELAY_MS + (2 * CHECK_MS); elapsed += CHECK_MS) {
+        now_ms += CHECK_MS;
+        firmware::settings_service(now_ms);
+    }
+}
+
+void test_change_is_written_once_settled()
+{
+    boot_blank();
+    CHECK(newest_record() == nullptr);
+
+    const uint8_t brightness = 40;
+    protocol_execute(firmware::CMD_SET_BRIGHTNESS, &brightness, 1);
+    now_ms += CHECK_MS;
+    firmware::settings_service(now_ms);
+    now_ms += firmware::SETTINGS_WRITE_DELAY_MS - CHECK_MS;
+    firmware::settings_service(now_ms);
+    CHECK(newest_record() == nullptr);
+
+    persist_brightness(brightness);
+    CHECK_EQ(valid_records(0) + valid_records(1), 1);
+    reboot();
+    CHECK_EQ(firmware::led_get_brightness(), brightness);
+}
+
+void test_full_sector_is_compacted()
+{
+    boot_blank();
+    // Fill one sector and spill three records into the other, then wrap back.
+    const uint32_t writes = (2 * RECORDS_PER_SECTOR) + 3;
+    for (uint32_t i = 0; i < writes; i++) {
+        persist_brightness(static_cast<uint8_t>(10 + (i % 80)));
+    }
+    const uint32_t first = valid_records(0);
+    const uint32_t second = valid_records(1);
+    CHECK_EQ(first + second, RECORDS_PER_SECTOR + 3);
+    // The sector written first was erased, not appended to.
+    CHECK(first == 3 || second == 3);
+    CHECK_EQ(sequence_of(newest_record()), writes);
+
+    reboot();
+    CHECK_EQ(firmware::led_get_brightness(), 10 + ((writes - 1) % 80));
+}
+
+void test_corrupt_record_is_ignored()
+{
+    boot_blank();
+    persist_brightness(40);
+    persist_brightness(70);
+
+    // Flip a bit of the newest record's settings, as a torn write would leave it.
+    uint8_t* torn = newest_record();
+    torn[sizeof(uint32_t) + 1] ^= 0x01u;
+    CHECK(!record_valid(torn));
+    reboot();
+    CHECK_EQ(firmware::led_get_brightness(), 40);
+
+    // The torn slot is not reused: the next record goes after it.
+    persist_brightness(55);
+    CHECK(newest_record() > torn);
+    reboot();
+    CHECK_EQ(firmware::led_get_brightness(), 55);
+}
+
+void test_no_valid_record_keeps_defaults()
+{
+    boot_blank();
+    persist_brightness(40);
+    uint8_t* only = newest_record();
+    only[RECORD_BYTES - 1] ^= 0x80u;
+    reboot();
+    CHECK_EQ(firmware::led_get_brightness(), firmware::DEFAULT_BRIGHTNESS);
+}
+
+} // namespace
+
+int main()
+{
+    RUN_TEST(test_change_is_written_once_settled);
+    RUN_TEST(test_full_sector_is_compacted);
+    RUN_TEST(test_corrupt_record_is_ignored);
+    RUN_TEST(test_no_valid_record_keeps_defaults);
+    return host::checks_passed() ? 0 : 1;
+}
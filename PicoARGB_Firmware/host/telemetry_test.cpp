@@ -0,0 +1,52 @@
+#include "check.h"
+#include "protocol.h"
+#include "telemetry.h"
+
+// Layout of the GET_TELEMETRY pages the host tools read.
+namespace {
+
+uint32_t read_u32(const uint8_t* data)
+{
+    return static_cast<uint32_t>(data[0]) | (static_cast<uint32_t>(data[1]) << 8)
+        | (static_cast<uint32_t>(data[2]) << 16) | (static_cast<uint32_t>(data[3]) << 24);
+}
+
+void test_usb_rx_page_counts_traffic()
+{
+    uint8_t report[64];
+    firmware::telemetry_write_report(firmware::TELEMETRY_PAGE_USB_RX, report, sizeof(report));
+    const uint32_t hid = read_u32(&report[2]);
+    const uint32_t vendor = read_u32(&report[6]);
+
+    for (int i = 0; i < 3; i++) {
+        firmware::telemetry_count_hid_report();
+    }
+    firmware::telemetry_count_vendor_frame();
+
+    CHECK_EQ(firmware::telemetry_write_report(firmware::TELEMETRY_PAGE_USB_RX, report, sizeof(report)),
+        sizeof(report));
+    CHECK_EQ(report[0], firmware::CMD_GET_TELEMETRY);
+    CHECK_EQ(report[1], firmware::TELEMETRY_PAGE_USB_RX);
+    CHECK_EQ(read_u32(&report[2]), hid + 3);
+    CHECK_EQ(read_u32(&report[6]), vendor + 1);
+}
+
+void test_unknown_page_is_empty()
+{
+    uint8_t report[64];
+    firmware::telemetry_count_hid_report();
+    firmware::telemetry_write_report(firmware::TELEMETRY_PAGE_COUNT, report, sizeof(report));
+    CHECK_EQ(report[1], firmware::TELEMETRY_PAGE_COUNT);
+    for (uint32_t i = 2; i < sizeof(report); i++) {
+        CHECK_EQ(report[i], 0);
+    }
+}
+
+} // namespace
+
+int main()
+{
+    RUN_TEST(test_usb_rx_page_counts_traffic);
+    RUN_TEST(test_unknown_page_is_empty);
+    return host::checks_passed() ? 0 : 1;
+}
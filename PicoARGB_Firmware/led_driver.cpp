@@ -1,57 +1,332 @@
 #include "led_driver.h"
 
+#include <math.h>
 #include "config.h"
-#include "hardware/pio.h"
-#include "ws2812.pio.h"
+#include "fixed_math.h"
+#include "led_output.h"
+#include "pixel_format.h"
+#include "telemetry.h"
 
 namespace firmware {
 namespace {
 
-Rgb leds[NUM_LEDS] = {};
-PIO ws2812_pio = pio0;
-uint ws2812_sm = 0;
+Rgb leds[MAX_LEDS] = {};
+uint16_t led_count = DEFAULT_NUM_LEDS;
+// Pixels past a shrunk active length that still need one black frame.
+uint16_t stale_count = 0;
 uint8_t global_brightness = DEFAULT_BRIGHTNESS;
 
-uint32_t pack_grb(uint8_t r, uint8_t g, uint8_t b)
+uint32_t last_output_us = 0;
+
+struct OutputSegment {
+    uint16_t start;
+    uint16_t length;
+    uint8_t format;
+};
+
+OutputSegment outputs[MAX_OUTPUT_CHANNELS] = {};
+
+bool show_deferred = false;
+bool show_requested = false;
+// Set when an output-stage setting changes, so the next frame is packed again even
+// when no pixel changed.
+bool output_dirty = false;
+
+// Calibration curves, (value / 255)^gamma * gain per channel in Q24, rebuilt only
+// when the host uploads a calibration. Brightness stays outside the power, since
+// (v * b)^g = v^g * b^g, so a brightness change needs no powf per entry.
+constexpr uint32_t CURVE_ONE = 1u << 24;
+ColorCalibration calibration = {
+    {255, 255, 255},
+    {DEFAULT_GAMMA_TENTHS, DEFAULT_GAMMA_TENTHS, DEFAULT_GAMMA_TENTHS},
+};
+uint32_t calibration_curves[3][256] = {};
+
+// Calibration and brightness folded into one 8.8 fixed-point table per channel,
+// rebuilt when either changes. The fraction is either rounded off or temporally
+// dithered.
+uint16_t output_luts[3][256] = {};
+bool dither_enabled = false;
+uint8_t dither_frame = 0;
+constexpr uint8_t DITHER_SEQUENCE[8] = {0x10, 0x90, 0x50, 0xD0, 0x30, 0xB0, 0x70, 0xF0};
+
+float gamma_exponent(uint8_t channel)
+{
+    return static_cast<float>(calibration.gamma[channel]) / 10.0f;
+}
+
+void rebuild_calibration_curves()
+{
+    for (uint channel = 0; channel < 3; channel++) {
+        const float exponent = gamma_exponent(channel);
+        const float gain = static_cast<float>(calibration.gain[channel]) * (static_cast<float>(CURVE_ONE) / 255.0f);
+        for (uint value = 0; value < 256; value++) {
+            const float level = powf(static_cast<float>(value) / 255.0f, exponent);
+            calibration_curves[channel][value] = static_cast<uint32_t>(level * gain + 0.5f);
+        }
+    }
+}
+
+void rebuild_output_lut()
+{
+    for (uint channel = 0; channel < 3; channel++) {
+        // Q16 brightness factor after this channel's gamma.
+        const float level = powf(static_cast<float>(global_brightness) / 100.0f, gamma_exponent(channel));
+        const uint64_t scale = static_cast<uint64_t>(level * 65536.0f + 0.5f) * 0xFF00u;
+        const uint32_t* curve = calibration_curves[channel];
+        for (uint value = 0; value < 256; value++) {
+            output_luts[channel][value] = static_cast<uint16_t>((curve[value] * scale + (1ull << 39)) >> 40);
+        }
+    }
+}
+
+// Packs `count` pixels in one format and returns non-zero when any word differs
+// from the previous frame. One instantiation per format keeps the loop branch-free.
+// Every channel is scaled by the Q16 power scale, and its unscaled 8.8 level is
+// added to `duty` for the power estimate.
+template <typename Format>
+uint32_t pack_pixels(uint32_t* out, const uint32_t* previous, const Rgb* pixels, uint16_t count, uint32_t rounding,
+    uint32_t scale, uint32_t* duty)
+{
+    uint32_t changed = 0;
+    uint32_t duty_r = 0;
+    uint32_t duty_g = 0;
+    uint32_t duty_b = 0;
+    for (uint i = 0; i < count; i++) {
+        const uint32_t r = output_luts[0][pixels[i].r];
+        const uint32_t g = output_luts[1][pixels[i].g];
+        const uint32_t b = output_luts[2][pixels[i].b];
+        duty_r += r;
+        duty_g += g;
+        duty_b += b;
+        const uint32_t channels[3] = {(r * scale) >> 16, (g * scale) >> 16, (b * scale) >> 16};
+        Format::pack(out, channels, rounding);
+        for (uint word = 0; word < Format::WORDS_PER_PIXEL; word++) {
+            changed |= out[word] ^ previous[word];
+        }
+        out += Format::WORDS_PER_PIXEL;
+        previous += Format::WORDS_PER_PIXEL;
+    }
+    duty[0] += duty_r;
+    duty[1] += duty_g;
+    duty[2] += duty_b;
+    return changed;
+}
+
+using PackFunction = uint32_t (*)(uint32_t*, const uint32_t*, const Rgb*, uint16_t, uint32_t, uint32_t, uint32_t*);
+
+// Indexed by PixelFormatId, like PIXEL_FORMATS.
+constexpr PackFunction PACKERS[PIXEL_FORMAT_COUNT] = {
+    pack_pixels<FormatGrb>,
+    pack_pixels<FormatRgb>,
+    pack_pixels<FormatBrg>,
+    pack_pixels<FormatGrbw>,
+    pack_pixels<FormatGrb16>,
+};
+
+PowerModel power = {0, {DEFAULT_CHANNEL_MA, DEFAULT_CHANNEL_MA, DEFAULT_CHANNEL_MA}, DEFAULT_IDLE_TENTHS_MA};
+// Q16 factor applied to every channel by the packers.
+uint32_t power_scale = Q16_ONE;
+bool power_settling = false;
+// The scale only recovers while the frame would fit in this share of the budget, so
+// a frame hovering at the limit does not pump; it then rises by at most one step
+// per frame.
+constexpr uint32_t POWER_RELEASE_SHARE = 15;
+constexpr uint32_t POWER_RELEASE_DIVISOR = 16;
+constexpr uint32_t POWER_RELEASE_STEP = Q16_ONE / 64;
+
+// Largest Q16 scale that keeps `channel_ma` (at full scale) within `budget_ma`.
+uint32_t scale_to_fit(uint64_t channel_ma, uint32_t budget_ma)
+{
+    if (channel_ma <= budget_ma) {
+        return Q16_ONE;
+    }
+    return static_cast<uint32_t>((static_cast<uint64_t>(budget_ma) << 16) / channel_ma);
+}
+
+// Updates power_scale from the unscaled duty of the frame just packed with it, and
+// returns the frame's estimated draw in mA at the new scale. `repack` is set when
+// the new scale is lower, i.e. the packed frame would exceed the budget.
+uint32_t update_power_scale(const uint32_t* duty, uint32_t pixels, bool& repack)
 {
-    return (static_cast<uint32_t>(g) << 16)
-        | (static_cast<uint32_t>(r) << 8)
-        | b;
+    repack = false;
+    power_settling = false;
+    // Duty sums are 8.8, so 0xFF00 is one channel at full duty.
+    const uint64_t channel_ma = (static_cast<uint64_t>(duty[0]) * power.channel_ma[0]
+        + static_cast<uint64_t>(duty[1]) * power.channel_ma[1]
+        + static_cast<uint64_t>(duty[2]) * power.channel_ma[2]) / 0xFF00u;
+    const uint32_t idle_ma = (pixels * power.idle_tenths_ma) / 10u;
+    if (power.budget_ma == 0) {
+        power_scale = Q16_ONE;
+        return static_cast<uint32_t>(channel_ma) + idle_ma;
+    }
+
+    const uint32_t budget_ma = (power.budget_ma > idle_ma) ? power.budget_ma - idle_ma : 0;
+    const uint32_t fit = scale_to_fit(channel_ma, budget_ma);
+    if (fit < power_scale) {
+        // Over budget: scale the whole frame down to the budget at once.
+        power_scale = fit;
+        repack = true;
+    } else {
+        const uint32_t release = scale_to_fit(channel_ma, budget_ma * POWER_RELEASE_SHARE / POWER_RELEASE_DIVISOR);
+        if (release > power_scale) {
+            const uint32_t stepped = power_scale + POWER_RELEASE_STEP;
+            power_scale = (stepped < release) ? stepped : release;
+            power_settling = power_scale < release;
+        }
+    }
+    return static_cast<uint32_t>((channel_ma * power_scale) >> 16) + idle_ma;
 }
 
-uint8_t scale_brightness(uint8_t value)
+// Packs every output's segment in its own format, one after the other, and returns
+// non-zero when the frame differs from the previous one.
+uint32_t pack_outputs(uint32_t* back, uint16_t length, uint32_t rounding, OutputSpan* spans, uint32_t* duty,
+    uint32_t& pixels)
 {
-    const uint16_t scaled = static_cast<uint16_t>(value) * global_brightness;
-    return static_cast<uint8_t>(scaled / 100);
+    const OutputSpan* previous_spans = nullptr;
+    const uint32_t* previous = led_output_last_frame(previous_spans);
+    uint32_t changed = 0;
+    uint16_t cursor = 0;
+    pixels = 0;
+    for (uint i = 0; i < MAX_OUTPUT_CHANNELS; i++) {
+        const OutputSegment& segment = outputs[i];
+        const uint8_t words_per_pixel = PIXEL_FORMATS[segment.format].words_per_pixel;
+        uint16_t count = 0;
+        if (segment.length != 0 && segment.start < length) {
+            const uint16_t available = length - segment.start;
+            count = (segment.length < available) ? segment.length : available;
+            const uint16_t room = static_cast<uint16_t>((FRAME_WORDS - cursor) / words_per_pixel);
+            count = (count < room) ? count : room;
+        }
+
+        spans[i] = {cursor, static_cast<uint16_t>(count * words_per_pixel)};
+        changed |= static_cast<uint32_t>(spans[i].offset != previous_spans[i].offset
+            || spans[i].count != previous_spans[i].count);
+        changed |= PACKERS[segment.format](&back[cursor], &previous[cursor], &leds[segment.start], count, rounding,
+            power_scale, duty);
+        cursor = static_cast<uint16_t>(cursor + spans[i].count);
+        pixels += count;
+    }
+    return changed;
 }
 
 } // namespace
 
 void led_driver_init()
 {
-    const uint offset = pio_add_program(ws2812_pio, &ws2812_program);
-    ws2812_sm = pio_claim_unused_sm(ws2812_pio, true);
-    ws2812_program_init(ws2812_pio, ws2812_sm, offset, WS2812_PIN, 800000, false);
+    led_output_init();
+    rebuild_calibration_curves();
+    rebuild_output_lut();
+
+    // Output 0 follows the whole active length until the host maps segments.
+    led_set_output(0, 0, MAX_LEDS);
     led_clear();
 }
 
-uint8_t apply_gamma(uint8_t value)
+bool led_set_output(uint8_t index, uint16_t start, uint16_t length)
+{
+    if (index >= MAX_OUTPUT_CHANNELS || start >= MAX_LEDS) {
+        return false;
+    }
+    if (length > MAX_LEDS - start) {
+        length = static_cast<uint16_t>(MAX_LEDS - start);
+    }
+    const uint8_t format = outputs[index].format;
+    if (length > 0 && !led_output_configure(index, PIXEL_FORMATS[format].bits_per_word)) {
+        return false;
+    }
+    outputs[index] = {start, length, format};
+    output_dirty = true;
+    return true;
+}
+
+bool led_set_output_format(uint8_t index, uint8_t format)
 {
-    if (value == 0) {
-        return 0;
+    if (index >= MAX_OUTPUT_CHANNELS || format >= PIXEL_FORMAT_COUNT) {
+        return false;
+    }
+    if (outputs[index].length > 0 && !led_output_configure(index, PIXEL_FORMATS[format].bits_per_word)) {
+        return false;
+    }
+    if (outputs[index].format != format) {
+        outputs[index].format = format;
+        output_dirty = true;
     }
+    return true;
+}
 
-#if ENABLE_GAMMA
-    const uint16_t corrected = static_cast<uint16_t>(value) * value + 127;
-    return static_cast<uint8_t>(corrected / 255);
-#else
-    return value;
-#endif
+uint8_t led_get_output_format(uint8_t index)
+{
+    return (index < MAX_OUTPUT_CHANNELS) ? outputs[index].format : static_cast<uint8_t>(PIXEL_FORMAT_GRB);
+}
+
+bool led_get_output(uint8_t index, uint16_t& start, uint16_t& length)
+{
+    if (index >= MAX_OUTPUT_CHANNELS) {
+        return false;
+    }
+    start = outputs[index].start;
+    length = outputs[index].length;
+    return true;
 }
 
 void led_set_brightness(uint8_t percent)
 {
-    global_brightness = (percent > 100) ? 100 : percent;
+    const uint8_t brightness = (percent > 100) ? 100 : percent;
+    if (brightness == global_brightness) {
+        return;
+    }
+    global_brightness = brightness;
+    rebuild_output_lut();
+    output_dirty = true;
+}
+
+bool led_set_calibration(const ColorCalibration& value)
+{
+    for (uint channel = 0; channel < 3; channel++) {
+        if (value.gamma[channel] < MIN_GAMMA_TENTHS || value.gamma[channel] > MAX_GAMMA_TENTHS) {
+            return false;
+        }
+    }
+    calibration = value;
+    rebuild_calibration_curves();
+    rebuild_output_lut();
+    output_dirty = true;
+    return true;
+}
+
+ColorCalibration led_get_calibration()
+{
+    return calibration;
+}
+
+void led_set_power_model(const PowerModel& model)
+{
+    power = model;
+    power_settling = true;
+}
+
+PowerModel led_get_power_model()
+{
+    return power;
+}
+
+bool led_power_settling()
+{
+    return power_settling;
+}
+
+void led_set_dither(bool enabled)
+{
+    if (dither_enabled != enabled) {
+        dither_enabled = enabled;
+        output_dirty = true;
+    }
+}
+
+bool led_get_dither()
+{
+    return dither_enabled;
 }
 
 uint8_t led_get_brightness()
@@ -59,21 +334,42 @@ uint8_t led_get_brightness()
     return global_brightness;
 }
 
-void led_set_pixel(uint8_t index, Rgb color)
+void led_set_pixel(uint16_t index, Rgb color)
 {
-    if (index >= NUM_LEDS) {
+    if (index >= led_count) {
         return;
     }
     leds[index] = color;
 }
 
+void led_write_rgb(uint16_t offset, const uint8_t* rgb, uint16_t count)
+{
+    if (offset >= led_count) {
+        return;
+    }
+    if (count > led_count - offset) {
+        count = static_cast<uint16_t>(led_count - offset);
+    }
+
+    Rgb* pixel = &leds[offset];
+    for (uint i = 0; i < count; i++) {
+        pixel[i] = {rgb[0], rgb[1], rgb[2]};
+        rgb += 3;
+    }
+}
+
 void led_fill(Rgb color)
 {
-    for (uint i = 0; i < NUM_LEDS; i++) {
+    for (uint i = 0; i < led_count; i++) {
         leds[i] = color;
     }
 }
 
+PixelSpan led_pixels()
+{
+    return {leds, led_count};
+}
+
 void led_clear()
 {
     led_fill({0, 0, 0});
@@ -82,14 +378,85 @@ void led_clear()
 
 void led_show()
 {
-    for (uint i = 0; i < NUM_LEDS; i++) {
-        const uint8_t r = apply_gamma(scale_brightness(leds[i].r));
-        const uint8_t g = apply_gamma(scale_brightness(leds[i].g));
-        const uint8_t b = apply_gamma(scale_brightness(leds[i].b));
-        pio_sm_put_blocking(ws2812_pio, ws2812_sm, pack_grb(r, g, b) << 8u);
+    if (show_deferred) {
+        show_requested = true;
+        return;
+    }
+
+    const uint32_t started_us = time_us_32();
+    const uint16_t length = (stale_count > led_count) ? stale_count : led_count;
+    const uint32_t rounding = dither_enabled ? DITHER_SEQUENCE[dither_frame++ & 7u] : 0x80u;
+    uint32_t* back = led_output_begin_frame();
+
+    OutputSpan spans[MAX_OUTPUT_CHANNELS];
+    uint32_t duty[3] = {};
+    uint32_t pixels = 0;
+    uint32_t changed = pack_outputs(back, length, rounding, spans, duty, pixels);
+    bool repack = false;
+    const uint32_t estimated_ma = update_power_scale(duty, pixels, repack);
+    if (repack) {
+        // Only on frames where the limiter tightens; the duty does not change.
+        uint32_t repacked_duty[3] = {};
+        changed = pack_outputs(back, length, rounding, spans, repacked_duty, pixels);
+    }
+    telemetry_record_power(estimated_ma, power_scale);
+    stale_count = 0;
+    output_dirty = false;
+
+    if (changed == 0 && !dither_enabled && !led_keepalive_due()) {
+        telemetry_count_output_skipped();
+    } else {
+        last_output_us = time_us_32();
+        led_output_submit(spans);
+    }
+    telemetry_record(TELEMETRY_OUTPUT, started_us);
+}
+
+bool led_output_dirty()
+{
+    return output_dirty;
+}
+
+bool led_keepalive_due()
+{
+    return LED_KEEPALIVE_MS != 0 && (time_us_32() - last_output_us) >= LED_KEEPALIVE_MS * 1000u;
+}
+
+void led_set_count(uint16_t count)
+{
+    if (count == 0) {
+        count = 1;
+    } else if (count > MAX_LEDS) {
+        count = MAX_LEDS;
+    }
+
+    // Blank the pixels that drop out so they do not keep their last color.
+    for (uint i = count; i < led_count; i++) {
+        leds[i] = {0, 0, 0};
+    }
+    if (count < led_count && led_count > stale_count) {
+        stale_count = led_count;
+    }
+    led_count = count;
+}
+
+uint16_t led_get_count()
+{
+    return led_count;
+}
+
+void led_defer_show(bool defer)
+{
+    show_deferred = defer;
+    if (!defer && show_requested) {
+        show_requested = false;
+        led_show();
     }
+}
 
-    sleep_us(60);
+bool led_frame_in_flight()
+{
+    return led_output_busy();
 }
 
 } // namespace firmware
@@ -10,14 +10,67 @@ struct Rgb {
     uint8_t b;
 };
 
+// Output calibration, per channel in R, G, B order: a white-point gain (255 =
+// unity) and a gamma exponent in tenths (10-40, i.e. 1.0-4.0).
+struct ColorCalibration {
+    uint8_t gain[3];
+    uint8_t gamma[3];
+};
+
+constexpr uint8_t MIN_GAMMA_TENTHS = 10;
+constexpr uint8_t MAX_GAMMA_TENTHS = 40;
+
+// Power limiter: frames whose estimated draw exceeds budget_ma are scaled down as a
+// whole. channel_ma is the draw of one channel at full duty, idle_tenths_ma that of a
+// dark LED in tenths of mA. A budget of 0 disables the limiter.
+struct PowerModel {
+    uint16_t budget_ma;
+    uint8_t channel_ma[3];
+    uint8_t idle_tenths_ma;
+};
+
+// The active part of the pixel arena, valid until the LED count changes.
+struct PixelSpan {
+    Rgb* data;
+    uint16_t count;
+};
+
 void led_driver_init();
-void led_set_pixel(uint8_t index, Rgb color);
+void led_set_pixel(uint16_t index, Rgb color);
+// Copies packed R,G,B bytes into the pixel arena, clipped to the active length.
+void led_write_rgb(uint16_t offset, const uint8_t* rgb, uint16_t count);
 void led_fill(Rgb color);
+PixelSpan led_pixels();
 void led_clear();
+// Packs and sends the arena; a frame identical to the last one sent is skipped
+// unless dither is on or the keep-alive refresh is due.
 void led_show();
+bool led_keepalive_due();
+// True when brightness, dither, calibration or an output's mapping or format changed
+// since the last led_show(), so even an unchanged frame has to be packed again.
+bool led_output_dirty();
+bool led_frame_in_flight();
+// While deferred, led_show() only records the request; releasing runs it once.
+void led_defer_show(bool defer);
+
+void led_set_count(uint16_t count);
+bool led_set_output(uint8_t index, uint16_t start, uint16_t length);
+bool led_get_output(uint8_t index, uint16_t& start, uint16_t& length);
+// Selects the chipset format (PixelFormatId) of an output.
+bool led_set_output_format(uint8_t index, uint8_t format);
+uint8_t led_get_output_format(uint8_t index);
+uint16_t led_get_count();
 
 void led_set_brightness(uint8_t percent);
 uint8_t led_get_brightness();
-uint8_t apply_gamma(uint8_t value);
+void led_set_dither(bool enabled);
+bool led_get_dither();
+bool led_set_calibration(const ColorCalibration& calibration);
+ColorCalibration led_get_calibration();
+void led_set_power_model(const PowerModel& model);
+PowerModel led_get_power_model();
+// True while the limiter's scale may still change (after a model change, or while it
+// rises back one step per frame sent), so even a static frame has to be re-sent.
+bool led_power_settling();
 
 } // namespace firmware
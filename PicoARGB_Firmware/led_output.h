@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdint.h>
+#include "config.h"
+#include "pixel_format.h"
+
+namespace firmware {
+
+// Packed frame capacity in words: the whole arena in the widest format.
+constexpr uint32_t FRAME_WORDS = MAX_LEDS * MAX_WORDS_PER_PIXEL;
+
+// The words of a packed frame that one output sends; count 0 leaves it idle.
+struct OutputSpan {
+    uint16_t offset;
+    uint16_t count;
+};
+
+// Transport behind led_show(). It owns the packed frame buffers and pushes them to
+// the LED lines: led_output_pio.cpp drives WS2812 outputs from PIO and DMA, and the
+// host build records the frames instead.
+void led_output_init();
+// Claims the output on first use and sets how many bits of each word it shifts
+// out (24 or 32), from the next frame on.
+bool led_output_configure(uint8_t index, uint8_t bits_per_word);
+
+// Returns the buffer for the next frame. The transport does not read it until
+// led_output_submit() hands it over with one span per output, and a frame submitted
+// while another is still on the wire replaces any frame already waiting.
+uint32_t* led_output_begin_frame();
+void led_output_submit(const OutputSpan* spans);
+// The newest frame that is still going to the LEDs and its spans, valid after
+// led_output_begin_frame().
+const uint32_t* led_output_last_frame(const OutputSpan*& spans);
+bool led_output_busy();
+// Re-derives the output timing after clk_sys changed. Only call while not busy.
+void led_output_clock_changed();
+
+} // namespace firmware
@@ -0,0 +1,258 @@
+#include "led_output.h"
+
+#include "config.h"
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/pio.h"
+#include "hardware/sync.h"
+#include "hardware/timer.h"
+#include "ws2812.pio.h"
+
+namespace firmware {
+namespace {
+
+constexpr uint32_t WS2812_FREQ_HZ = 800000;
+constexpr uint32_t WS2812_LATCH_US = 60;
+
+// The DMA finishes once the last word is in the joined TX FIFO; the PIO still
+// has to shift out the FIFO and OSR before the line can be held low to latch.
+constexpr uint32_t drain_us(uint32_t bits_per_word)
+{
+    return ((8u + 1u) * bits_per_word * 1000000u) / WS2812_FREQ_HZ;
+}
+
+// One PIO state machine and DMA channel per output. Each output transmits its own
+// span of the packed frame, and all of them are started together.
+struct OutputChannel {
+    PIO pio = nullptr;
+    uint sm = 0;
+    uint dma = 0;
+    uint offset = 0;
+    // Bits shifted out per word: requested, and currently set in the state machine.
+    uint8_t bits = 24;
+    uint8_t applied_bits = 24;
+};
+
+OutputChannel channels[MAX_OUTPUT_CHANNELS] = {};
+int ws2812_offsets[2] = {-1, -1};
+
+// Packed words. The DMAs read the front buffer while led_show() packs the back one.
+uint32_t frame_buffers[2][FRAME_WORDS] = {};
+OutputSpan frame_spans[2][MAX_OUTPUT_CHANNELS] = {};
+uint8_t front_index = 0;
+uint latch_alarm = 0;
+volatile uint32_t dma_busy_mask = 0;
+volatile bool frame_in_flight = false;
+volatile bool frame_pending = false;
+// Widest word among the outputs of the frame in flight; sets the drain time.
+volatile uint8_t frame_bits = 24;
+
+void latch_complete(uint alarm_num);
+
+// The state machine is drained between frames, so a new pull threshold is applied
+// there. Restarting clears the OSR shift count, which would otherwise still hold
+// the old threshold's leftover bits.
+void apply_word_bits(OutputChannel& channel)
+{
+    pio_sm_set_enabled(channel.pio, channel.sm, false);
+    hw_write_masked(&channel.pio->sm[channel.sm].shiftctrl,
+        static_cast<uint32_t>(channel.bits & 0x1Fu) << PIO_SM0_SHIFTCTRL_PULL_THRESH_LSB,
+        PIO_SM0_SHIFTCTRL_PULL_THRESH_BITS);
+    pio_sm_restart(channel.pio, channel.sm);
+    pio_sm_exec(channel.pio, channel.sm, pio_encode_jmp(channel.offset));
+    pio_sm_set_enabled(channel.pio, channel.sm, true);
+    channel.applied_bits = channel.bits;
+}
+
+// Must run with interrupts disabled or from the latch alarm.
+void start_transfer()
+{
+    front_index ^= 1u;
+    frame_pending = false;
+
+    const uint32_t* front = frame_buffers[front_index];
+    const OutputSpan* spans = frame_spans[front_index];
+    uint32_t start_mask = 0;
+    uint8_t widest_bits = 0;
+    for (uint i = 0; i < MAX_OUTPUT_CHANNELS; i++) {
+        OutputChannel& channel = channels[i];
+        if (channel.pio == nullptr || spans[i].count == 0) {
+            continue;
+        }
+
+        if (channel.bits != channel.applied_bits) {
+            apply_word_bits(channel);
+        }
+        if (channel.bits > widest_bits) {
+            widest_bits = channel.bits;
+        }
+        dma_channel_set_read_addr(channel.dma, front + spans[i].offset, false);
+        dma_channel_set_trans_count(channel.dma, spans[i].count, false);
+        start_mask |= 1u << channel.dma;
+    }
+
+    frame_bits = widest_bits;
+    dma_busy_mask = start_mask;
+    frame_in_flight = (start_mask != 0);
+    if (start_mask != 0) {
+        dma_start_channel_mask(start_mask);
+    }
+}
+
+void latch_complete(uint alarm_num)
+{
+    (void)alarm_num;
+    frame_in_flight = false;
+    if (frame_pending) {
+        start_transfer();
+    }
+    // Wakes the render loop if it is waiting for the output to render a frame.
+    __sev();
+}
+
+void dma_complete()
+{
+    const uint32_t busy = dma_busy_mask;
+    uint32_t finished = 0;
+    for (const OutputChannel& channel : channels) {
+        if (channel.pio != nullptr && (busy & (1u << channel.dma)) != 0 && dma_channel_get_irq0_status(channel.dma)) {
+            dma_channel_acknowledge_irq0(channel.dma);
+            finished |= 1u << channel.dma;
+        }
+    }
+    if (finished == 0) {
+        return;
+    }
+
+    // Outputs run in parallel, so the latch only waits for the last one to finish.
+    dma_busy_mask = busy & ~finished;
+    if (dma_busy_mask == 0
+        && hardware_alarm_set_target(latch_alarm, make_timeout_time_us(drain_us(frame_bits) + WS2812_LATCH_US))) {
+        latch_complete(latch_alarm);
+    }
+}
+
+bool claim_output(uint8_t index, uint8_t bits)
+{
+    OutputChannel& channel = channels[index];
+    if (channel.pio != nullptr) {
+        return true;
+    }
+
+    // The first four outputs use pio0, the rest pio1.
+    const uint pio_index = (index < NUM_PIO_STATE_MACHINES) ? 0u : 1u;
+    PIO pio = (pio_index == 0) ? pio0 : pio1;
+    if (ws2812_offsets[pio_index] < 0) {
+        if (!pio_can_add_program(pio, &ws2812_program)) {
+            return false;
+        }
+        ws2812_offsets[pio_index] = static_cast<int>(pio_add_program(pio, &ws2812_program));
+    }
+
+    const int sm = pio_claim_unused_sm(pio, false);
+    const int dma = dma_claim_unused_channel(false);
+    if (sm < 0 || dma < 0) {
+        // Give back whichever one was claimed, so a retry can still find it.
+        if (sm >= 0) {
+            pio_sm_unclaim(pio, static_cast<uint>(sm));
+        }
+        if (dma >= 0) {
+            dma_channel_unclaim(static_cast<uint>(dma));
+        }
+        LOGF("Output %u: no free PIO state machine or DMA channel\n", index);
+        return false;
+    }
+
+    ws2812_program_init(pio, static_cast<uint>(sm), static_cast<uint>(ws2812_offsets[pio_index]),
+        OUTPUT_CHANNEL_PINS[index], WS2812_FREQ_HZ, bits == 32);
+
+    dma_channel_config dma_config = dma_channel_get_default_config(static_cast<uint>(dma));
+    channel_config_set_transfer_data_size(&dma_config, DMA_SIZE_32);
+    channel_config_set_read_increment(&dma_config, true);
+    channel_config_set_write_increment(&dma_config, false);
+    channel_config_set_dreq(&dma_config, pio_get_dreq(pio, static_cast<uint>(sm), true));
+    dma_channel_configure(static_cast<uint>(dma), &dma_config, &pio->txf[sm], nullptr, 0, false);
+    dma_channel_set_irq0_enabled(static_cast<uint>(dma), true);
+
+    channel.sm = static_cast<uint>(sm);
+    channel.dma = static_cast<uint>(dma);
+    channel.offset = static_cast<uint>(ws2812_offsets[pio_index]);
+    channel.bits = bits;
+    channel.applied_bits = bits;
+    channel.pio = pio;
+    return true;
+}
+
+} // namespace
+
+void led_output_init()
+{
+    latch_alarm = static_cast<uint>(hardware_alarm_claim_unused(true));
+    hardware_alarm_set_callback(latch_alarm, latch_complete);
+    irq_add_shared_handler(DMA_IRQ_0, dma_complete, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_enabled(DMA_IRQ_0, true);
+}
+
+bool led_output_configure(uint8_t index, uint8_t bits_per_word)
+{
+    if (index >= MAX_OUTPUT_CHANNELS || (bits_per_word != 24 && bits_per_word != 32)) {
+        return false;
+    }
+    if (!claim_output(index, bits_per_word)) {
+        return false;
+    }
+
+    const uint32_t irq_state = save_and_disable_interrupts();
+    channels[index].bits = bits_per_word;
+    restore_interrupts(irq_state);
+    return true;
+}
+
+uint32_t* led_output_begin_frame()
+{
+    // Keep the latch alarm from swapping in the back buffer while it is being packed.
+    const uint32_t irq_state = save_and_disable_interrupts();
+    frame_pending = false;
+    restore_interrupts(irq_state);
+    return frame_buffers[front_index ^ 1u];
+}
+
+void led_output_submit(const OutputSpan* spans)
+{
+    const uint32_t irq_state = save_and_disable_interrupts();
+    for (uint i = 0; i < MAX_OUTPUT_CHANNELS; i++) {
+        frame_spans[front_index ^ 1u][i] = spans[i];
+    }
+    if (frame_in_flight) {
+        frame_pending = true;
+    } else {
+        start_transfer();
+    }
+    restore_interrupts(irq_state);
+}
+
+const uint32_t* led_output_last_frame(const OutputSpan*& spans)
+{
+    spans = frame_spans[front_index];
+    return frame_buffers[front_index];
+}
+
+bool led_output_busy()
+{
+    return frame_in_flight || frame_pending;
+}
+
+void led_output_clock_changed()
+{
+    const float div = static_cast<float>(clock_get_hz(clk_sys))
+        / (WS2812_FREQ_HZ * (ws2812_T1 + ws2812_T2 + ws2812_T3));
+    for (const OutputChannel& channel : channels) {
+        if (channel.pio != nullptr) {
+            pio_sm_set_clkdiv(channel.pio, channel.sm, div);
+            pio_sm_clkdiv_restart(channel.pio, channel.sm);
+        }
+    }
+}
+
+} // namespace firmware
@@ -1,11 +1,44 @@
 #include "bsp/board.h"
+#include "hardware/structs/scb.h"
+#include "pico/flash.h"
+#include "pico/multicore.h"
 #include "pico/stdlib.h"
 #include "tusb.h"
 
 #include "config.h"
 #include "effects.h"
+#include "frame_scheduler.h"
 #include "led_driver.h"
 #include "protocol.h"
+#include "settings.h"
+#include "usb_device.h"
+
+namespace {
+
+// Core 1 owns the effect state, rendering and LED output. The LED driver is
+// initialised here so its DMA and latch interrupts are serviced on this core.
+void render_core_main()
+{
+    firmware::led_driver_init();
+    firmware::effects_init();
+    firmware::settings_load();
+    firmware::effects_request_startup();
+    firmware::frame_scheduler_init();
+
+    while (true) {
+        firmware::protocol_process_commands();
+        firmware::settings_service(to_ms_since_boot(get_absolute_time()));
+        // A frame still being sent keeps its deadline pending; the latch interrupt
+        // wakes the loop to render it.
+        uint32_t frame_ms = 0;
+        if (firmware::frame_scheduler_frame_due(frame_ms) && firmware::effects_update(frame_ms)) {
+            firmware::frame_scheduler_frame_done();
+        }
+        firmware::frame_scheduler_sleep();
+    }
+}
+
+} // namespace
 
 int main()
 {
@@ -13,21 +46,24 @@ int main()
     board_init();
 
     firmware::debug_init();
-    firmware::led_driver_init();
-    firmware::effects_init();
+    // Settings writes run on core 1 and pause this core while flash is busy.
+    flash_safe_execute_core_init();
+    multicore_launch_core1(render_core_main);
     tusb_init();
 
     firmware::protocol_log_banner();
-    firmware::effects_request_startup();
 
+    // Core 0 only runs the USB stack; host commands reach core 1 through the command queue.
+    // It sleeps between USB interrupts: with SEVONPEND an interrupt raised before the
+    // wait still ends it, and the timeout keeps the debug and vendor timers running.
+    scb_hw->scr |= M0PLUS_SCR_SEVONPEND_BITS;
     while (true) {
         tud_task();
 
         const uint32_t now_ms = to_ms_since_boot(get_absolute_time());
         firmware::debug_service(now_ms);
-        firmware::effects_update(now_ms);
-
-        tight_loop_contents();
+        firmware::usb_device_service();
+        best_effort_wfe_or_timeout(make_timeout_time_ms(firmware::USB_WAKE_MS));
     }
 
     return 0;
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <stdint.h>
+
+// Wire formats of the supported LED chipsets. Each format is a compile-time
+// specialisation, so its packing loop has no per-pixel branches on the format; the
+// runtime choice is made once per output by indexing PIXEL_FORMATS.
+namespace firmware {
+
+// Per-output formats, as sent over HID.
+enum PixelFormatId : uint8_t {
+    // WS2812/WS2813 and most ARGB fans.
+    PIXEL_FORMAT_GRB = 0,
+    PIXEL_FORMAT_RGB = 1,
+    PIXEL_FORMAT_BRG = 2,
+    // SK6812 RGBW: the common part of R, G and B drives the white LED.
+    PIXEL_FORMAT_GRBW = 3,
+    // 16 bits per channel (WS2816 and similar), sent as two 24-bit words.
+    PIXEL_FORMAT_GRB16 = 4,
+    PIXEL_FORMAT_COUNT,
+};
+
+// Words per pixel of the widest format, for sizing the packed frame buffers.
+constexpr uint8_t MAX_WORDS_PER_PIXEL = 2;
+
+namespace detail {
+
+enum ColorChannel : uint8_t {
+    CHANNEL_R = 0,
+    CHANNEL_G = 1,
+    CHANNEL_B = 2,
+};
+
+inline uint32_t min_u32(uint32_t a, uint32_t b)
+{
+    // Branch-free: the mask is all ones when a < b.
+    const uint32_t mask = 0u - static_cast<uint32_t>(a < b);
+    return b ^ ((a ^ b) & mask);
+}
+
+// Channel values arrive as 8.8 fixed point (0..0xFF00), after brightness and gamma.
+// Words are shifted out MSB first.
+template <ColorChannel First, ColorChannel Second, ColorChannel Third, bool White, bool Wide>
+struct PixelFormat {
+    static_assert(!(White && Wide), "no 16-bit RGBW chipset is supported");
+
+    static constexpr uint8_t WORDS_PER_PIXEL = Wide ? 2 : 1;
+    static constexpr uint8_t BITS_PER_WORD = White ? 32 : 24;
+
+    static void pack(uint32_t* out, const uint32_t* channels, uint32_t rounding)
+    {
+        uint32_t c0 = channels[First];
+        uint32_t c1 = channels[Second];
+        uint32_t c2 = channels[Third];
+        if constexpr (Wide) {
+            (void)rounding;
+            // 0xFF00 becomes 0xFFFF, so full scale stays full scale.
+            c0 += c0 >> 8;
+            c1 += c1 >> 8;
+            c2 += c2 >> 8;
+            out[0] = (c0 << 16) | (c1 & 0xFF00u);
+            out[1] = ((c1 & 0xFFu) << 24) | (c2 << 8);
+        } else if constexpr (White) {
+            const uint32_t w = min_u32(min_u32(c0, c1), c2);
+            out[0] = (((c0 - w + rounding) >> 8) << 24) | (((c1 - w + rounding) >> 8) << 16)
+                | (((c2 - w + rounding) >> 8) << 8) | ((w + rounding) >> 8);
+        } else {
+            out[0] = (((c0 + rounding) >> 8) << 24) | (((c1 + rounding) >> 8) << 16) | (((c2 + rounding) >> 8) << 8);
+        }
+    }
+};
+
+} // namespace detail
+
+using FormatGrb = detail::PixelFormat<detail::CHANNEL_G, detail::CHANNEL_R, detail::CHANNEL_B, false, false>;
+using FormatRgb = detail::PixelFormat<detail::CHANNEL_R, detail::CHANNEL_G, detail::CHANNEL_B, false, false>;
+using FormatBrg = detail::PixelFormat<detail::CHANNEL_B, detail::CHANNEL_R, detail::CHANNEL_G, false, false>;
+using FormatGrbw = detail::PixelFormat<detail::CHANNEL_G, detail::CHANNEL_R, detail::CHANNEL_B, true, false>;
+using FormatGrb16 = detail::PixelFormat<detail::CHANNEL_G, detail::CHANNEL_R, detail::CHANNEL_B, false, true>;
+
+// What the output transport needs to know about a format.
+struct PixelFormatInfo {
+    uint8_t words_per_pixel;
+    uint8_t bits_per_word;
+};
+
+template <typename Format>
+constexpr PixelFormatInfo format_info()
+{
+    return {Format::WORDS_PER_PIXEL, Format::BITS_PER_WORD};
+}
+
+// Indexed by PixelFormatId.
+constexpr PixelFormatInfo PIXEL_FORMATS[PIXEL_FORMAT_COUNT] = {
+    format_info<FormatGrb>(),
+    format_info<FormatRgb>(),
+    format_info<FormatBrg>(),
+    format_info<FormatGrbw>(),
+    format_info<FormatGrb16>(),
+};
+
+} // namespace firmware
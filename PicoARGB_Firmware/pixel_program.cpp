@@ -0,0 +1,175 @@
+#include "pixel_program.h"
+
+#include <string.h>
+#include "config.h"
+#include "fixed_math.h"
+
+namespace firmware {
+namespace {
+
+constexpr uint16_t PROGRAM_BYTES = MAX_PROGRAM_INSTRUCTIONS * PROGRAM_INSTRUCTION_BYTES;
+
+// Decoded once at load, so the interpreter never re-reads immediates.
+struct Instruction {
+    uint8_t op;
+    uint8_t dst;
+    uint8_t a;
+    uint8_t b;
+    int32_t immediate;
+};
+
+uint8_t staged[PROGRAM_BYTES];
+Instruction program[MAX_PROGRAM_INSTRUCTIONS];
+uint8_t program_length = 0;
+
+// Register arithmetic wraps instead of overflowing.
+int32_t wrap_add(int32_t a, int32_t b)
+{
+    return static_cast<int32_t>(static_cast<uint32_t>(a) + static_cast<uint32_t>(b));
+}
+
+int32_t wrap_sub(int32_t a, int32_t b)
+{
+    return static_cast<int32_t>(static_cast<uint32_t>(a) - static_cast<uint32_t>(b));
+}
+
+int32_t to_register(uint8_t value)
+{
+    return static_cast<int32_t>(value * 257u);
+}
+
+// Rounds, so a channel loaded with to_register() comes back unchanged.
+uint8_t to_channel(int32_t value)
+{
+    if (value <= 0) {
+        return 0;
+    }
+    return (value >= static_cast<int32_t>(Q16_ONE)) ? 255 : static_cast<uint8_t>((value * 255 + 0x8000) >> 16);
+}
+
+bool validate(const Instruction& instruction, uint8_t pc, uint8_t length)
+{
+    switch (instruction.op) {
+    case PROGRAM_OP_LOAD:
+        return instruction.dst < PROGRAM_REGISTERS;
+    case PROGRAM_OP_HUE:
+        return instruction.dst + 3u <= PROGRAM_REGISTERS && instruction.a < PROGRAM_REGISTERS
+            && instruction.b < PROGRAM_REGISTERS;
+    case PROGRAM_OP_SKIP_LT:
+    case PROGRAM_OP_SKIP_GE:
+        // dst is a skip count here, and may not jump past the end.
+        return pc + 1u + instruction.dst <= length && instruction.a < PROGRAM_REGISTERS
+            && instruction.b < PROGRAM_REGISTERS;
+    default:
+        return instruction.op < PROGRAM_OP_COUNT && instruction.dst < PROGRAM_REGISTERS
+            && instruction.a < PROGRAM_REGISTERS && instruction.b < PROGRAM_REGISTERS;
+    }
+}
+
+void run(int32_t* r)
+{
+    for (uint32_t pc = 0; pc < program_length; pc++) {
+        const Instruction& i = program[pc];
+        const int32_t a = r[i.a];
+        const int32_t b = r[i.b];
+        switch (i.op) {
+        case PROGRAM_OP_LOAD: r[i.dst] = i.immediate; break;
+        case PROGRAM_OP_MOV: r[i.dst] = a; break;
+        case PROGRAM_OP_ADD: r[i.dst] = wrap_add(a, b); break;
+        case PROGRAM_OP_SUB: r[i.dst] = wrap_sub(a, b); break;
+        case PROGRAM_OP_MUL: r[i.dst] = static_cast<int32_t>((static_cast<int64_t>(a) * b) >> 16); break;
+        case PROGRAM_OP_DIV:
+            r[i.dst] = (b == 0) ? 0 : static_cast<int32_t>((static_cast<int64_t>(a) * Q16_ONE) / b);
+            break;
+        case PROGRAM_OP_MIN: r[i.dst] = (a < b) ? a : b; break;
+        case PROGRAM_OP_MAX: r[i.dst] = (a > b) ? a : b; break;
+        case PROGRAM_OP_FRAC: r[i.dst] = a & 0xFFFF; break;
+        case PROGRAM_OP_SIN: r[i.dst] = sin_q15(static_cast<uint32_t>(a) << 16) * 2; break;
+        case PROGRAM_OP_ABS: r[i.dst] = (a < 0) ? wrap_sub(0, a) : a; break;
+        case PROGRAM_OP_HUE: {
+            const Rgb color = hsv_to_rgb(static_cast<uint16_t>(a), 255, 255);
+            r[i.dst] = to_register(color.r);
+            r[i.dst + 1] = to_register(color.g);
+            r[i.dst + 2] = to_register(color.b);
+            break;
+        }
+        case PROGRAM_OP_SKIP_LT:
+            if (a < b) {
+                pc += i.dst;
+            }
+            break;
+        case PROGRAM_OP_SKIP_GE:
+        default:
+            if (a >= b) {
+                pc += i.dst;
+            }
+            break;
+        }
+    }
+}
+
+} // namespace
+
+bool program_write(uint16_t offset, const uint8_t* data, uint16_t size)
+{
+    if (offset > PROGRAM_BYTES || size > PROGRAM_BYTES - offset) {
+        return false;
+    }
+    memcpy(&staged[offset], data, size);
+    return true;
+}
+
+bool program_load(uint16_t size)
+{
+    if (size == 0 || size > PROGRAM_BYTES || size % PROGRAM_INSTRUCTION_BYTES != 0) {
+        return false;
+    }
+
+    const uint8_t length = static_cast<uint8_t>(size / PROGRAM_INSTRUCTION_BYTES);
+    Instruction decoded[MAX_PROGRAM_INSTRUCTIONS];
+    for (uint8_t pc = 0; pc < length; pc++) {
+        const uint8_t* code = &staged[pc * PROGRAM_INSTRUCTION_BYTES];
+        const int16_t immediate = static_cast<int16_t>(code[2] | (code[3] << 8));
+        decoded[pc] = {code[0], code[1], code[2], code[3], static_cast<int32_t>(immediate) * 256};
+        if (!validate(decoded[pc], pc, length)) {
+            LOGF("Program instruction %u invalid\n", pc);
+            return false;
+        }
+        // The interpreter reads both operand registers of every instruction.
+        if (decoded[pc].op == PROGRAM_OP_LOAD) {
+            decoded[pc].a = 0;
+            decoded[pc].b = 0;
+        }
+    }
+
+    memcpy(program, decoded, length * sizeof(Instruction));
+    program_length = length;
+    return true;
+}
+
+void program_render(const ProgramInputs& inputs, PixelSpan pixels)
+{
+    if (program_length == 0) {
+        memset(pixels.data, 0, pixels.count * sizeof(Rgb));
+        return;
+    }
+
+    int32_t r[PROGRAM_REGISTERS];
+    const int32_t position_step = static_cast<int32_t>(Q16_ONE / pixels.count);
+    for (uint i = 0; i < pixels.count; i++) {
+        memset(r, 0, sizeof(r));
+        r[PROGRAM_REG_INDEX] = static_cast<int32_t>(i << 16);
+        r[PROGRAM_REG_POSITION] = static_cast<int32_t>(i) * position_step;
+        r[PROGRAM_REG_TIME] = static_cast<int32_t>(inputs.time);
+        r[PROGRAM_REG_MUSIC] = static_cast<int32_t>(inputs.music);
+        r[PROGRAM_REG_COLOR] = to_register(inputs.color.r);
+        r[PROGRAM_REG_COLOR + 1] = to_register(inputs.color.g);
+        r[PROGRAM_REG_COLOR + 2] = to_register(inputs.color.b);
+        r[PROGRAM_REG_COUNT] = static_cast<int32_t>(static_cast<uint32_t>(pixels.count) << 16);
+        run(r);
+        pixels.data[i] = {to_channel(r[PROGRAM_REG_OUT]), to_channel(r[PROGRAM_REG_OUT + 1]),
+            to_channel(r[PROGRAM_REG_OUT + 2])};
+    }
+}
+
+} // namespace firmware
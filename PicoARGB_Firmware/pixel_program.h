@@ -0,0 +1,69 @@
+#pragma once
+
+#include <stdint.h>
+#include "led_driver.h"
+
+namespace firmware {
+
+// User-defined per-pixel effects, run by EFFECT_MODE_PROGRAM.
+//
+// A program is up to MAX_PROGRAM_INSTRUCTIONS instructions of [op][dst][a][b] over
+// PROGRAM_REGISTERS signed Q16 registers (65536 = 1.0). Before each pixel:
+//   r0 index, r1 position along the strip (0..1), r2 time in seconds (wraps),
+//   r3 music level (0..1), r4-r6 base color R,G,B (0..1), r7 LED count;
+// the other registers start at 0. Afterwards r8-r10 are the pixel's R,G,B, clamped
+// to 0..1. Branches only skip forward, so no pixel runs more instructions than the
+// program has.
+constexpr uint8_t MAX_PROGRAM_INSTRUCTIONS = 64;
+constexpr uint8_t PROGRAM_REGISTERS = 16;
+constexpr uint8_t PROGRAM_INSTRUCTION_BYTES = 4;
+
+enum ProgramRegister : uint8_t {
+    PROGRAM_REG_INDEX = 0,
+    PROGRAM_REG_POSITION = 1,
+    PROGRAM_REG_TIME = 2,
+    PROGRAM_REG_MUSIC = 3,
+    PROGRAM_REG_COLOR = 4,
+    PROGRAM_REG_COUNT = 7,
+    PROGRAM_REG_OUT = 8,
+};
+
+enum ProgramOp : uint8_t {
+    // dst = a | b << 8 as a signed Q8.8 immediate.
+    PROGRAM_OP_LOAD = 0,
+    PROGRAM_OP_MOV = 1,
+    PROGRAM_OP_ADD = 2,
+    PROGRAM_OP_SUB = 3,
+    PROGRAM_OP_MUL = 4,
+    // Division by zero gives 0.
+    PROGRAM_OP_DIV = 5,
+    PROGRAM_OP_MIN = 6,
+    PROGRAM_OP_MAX = 7,
+    // dst = fractional part of a, always 0..1.
+    PROGRAM_OP_FRAC = 8,
+    // dst = sin(a turns), -1..1.
+    PROGRAM_OP_SIN = 9,
+    PROGRAM_OP_ABS = 10,
+    // dst..dst+2 = R,G,B of hue a (turns) at full saturation and value.
+    PROGRAM_OP_HUE = 11,
+    // Skip the next dst instructions when a < b (or a >= b).
+    PROGRAM_OP_SKIP_LT = 12,
+    PROGRAM_OP_SKIP_GE = 13,
+    PROGRAM_OP_COUNT,
+};
+
+struct ProgramInputs {
+    uint32_t time;
+    uint32_t music;
+    Rgb color;
+};
+
+// Upload: code bytes are staged at a byte offset, then load checks the first
+// `size` staged bytes and, when they form a valid program, replaces the running one.
+bool program_write(uint16_t offset, const uint8_t* data, uint16_t size);
+bool program_load(uint16_t size);
+
+// Runs the program once per pixel; black when no program is loaded.
+void program_render(const ProgramInputs& inputs, PixelSpan pixels);
+
+} // namespace firmware
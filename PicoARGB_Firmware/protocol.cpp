@@ -1,71 +1,63 @@
 #include "protocol.h"
 
-#include <string.h>
+#include "animation.h"
+#include "command_queue.h"
 #include "config.h"
 #include "effects.h"
+#include "pixel_program.h"
 #include "led_driver.h"
-#include "tusb.h"
+#include "settings.h"
+#include "telemetry.h"
 
 namespace firmware {
 namespace {
 
-struct ParsedHidCommand {
-    uint8_t command = 0;
-    const uint8_t* payload = nullptr;
-    uint16_t payload_size = 0;
-};
-
-bool usb_connected = false;
-uint16_t string_descriptor[32];
-
-uint8_t const hid_report_descriptor[] = {
-    0x06, 0x00, 0xFF, 0x09, 0x01, 0xA1, 0x01,
-    0x15, 0x00, 0x26, 0xFF, 0x00,
-    0x75, 0x08, 0x95, 0x40,
-    0x09, 0x01, 0x81, 0x02,
-    0x09, 0x01, 0x91, 0x02,
-    0xC0
-};
-
-tusb_desc_device_t const device_descriptor = {
-    .bLength = sizeof(tusb_desc_device_t),
-    .bDescriptorType = TUSB_DESC_DEVICE,
-    .bcdUSB = 0x0200,
-    .bDeviceClass = 0x00,
-    .bDeviceSubClass = 0x00,
-    .bDeviceProtocol = 0x00,
-    .bMaxPacketSize0 = 64,
-    .idVendor = USB_VID,
-    .idProduct = USB_PID,
-    .bcdDevice = 0x0100,
-    .iManufacturer = 0x01,
-    .iProduct = 0x02,
-    .iSerialNumber = 0x03,
-    .bNumConfigurations = 0x01,
-};
-
-enum {
-    ITF_NUM_HID,
-    ITF_TOTAL,
-};
-
-constexpr uint8_t EPNUM_HID_IN = 0x81;
-constexpr uint16_t CONFIG_TOTAL_LEN = TUD_CONFIG_DESC_LEN + TUD_HID_DESC_LEN;
-
-uint8_t const configuration_descriptor[] = {
-    TUD_CONFIG_DESCRIPTOR(1, ITF_TOTAL, 0, CONFIG_TOTAL_LEN, TUSB_DESC_CONFIG_ATT_REMOTE_WAKEUP, 100),
-    TUD_HID_DESCRIPTOR(ITF_NUM_HID, 4, HID_ITF_PROTOCOL_NONE, sizeof(hid_report_descriptor), EPNUM_HID_IN, 64, 10),
-};
-
-const char* const string_descriptors[] = {
-    nullptr,
-    "OpenRGB Project",
-    "Pico ARGB Controller",
-    "PICO-AR12-001",
-    "HID Interface",
-};
-
-ParsedHidCommand parse_hid_command(const uint8_t* buffer, uint16_t size)
+uint8_t clamp_percent(uint8_t value)
+{
+    return (value > 100) ? 100 : value;
+}
+
+uint16_t read_u16(const uint8_t* data)
+{
+    return static_cast<uint16_t>(data[0] | (data[1] << 8));
+}
+
+uint32_t read_u32(const uint8_t* data)
+{
+    return static_cast<uint32_t>(read_u16(data)) | (static_cast<uint32_t>(read_u16(&data[2])) << 16);
+}
+
+void execute_batch(const uint8_t* payload, uint16_t payload_size)
+{
+    uint16_t position = 0;
+    uint8_t applied = 0;
+    while (payload_size - position >= 2) {
+        const uint8_t command = payload[position];
+        const uint8_t length = payload[position + 1];
+        position += 2;
+        if (command == 0) {
+            break;
+        }
+        if (length > payload_size - position) {
+            LOGF("BATCH truncated at entry %u\n", applied);
+            break;
+        }
+
+        if (command == CMD_BATCH || command == CMD_PING || command == CMD_GET_TELEMETRY
+            || command >= CMD_INTERNAL_USB_MOUNTED) {
+            LOGF("BATCH entry 0x%02X not allowed\n", command);
+        } else {
+            protocol_execute(command, &payload[position], length);
+            applied++;
+        }
+        position += length;
+    }
+    LOGF("BATCH applied=%u\n", applied);
+}
+
+} // namespace
+
+ParsedHidCommand protocol_parse_report(const uint8_t* buffer, uint16_t size)
 {
     ParsedHidCommand parsed;
     if (size == 0) {
@@ -84,229 +76,329 @@ ParsedHidCommand parse_hid_command(const uint8_t* buffer, uint16_t size)
     return parsed;
 }
 
-void debug_buffer(const char* prefix, const uint8_t* buffer, uint16_t size)
-{
-#if DEBUG_LOG
-    LOGF("%s size=%u hex=", prefix, size);
-    for (uint16_t i = 0; i < size && i < 32; i++) {
-        LOGF("%02X ", buffer[i]);
-    }
-    LOGF("ascii=");
-    for (uint16_t i = 0; i < size && i < 32; i++) {
-        LOGF("%c", (buffer[i] >= 32 && buffer[i] <= 126) ? buffer[i] : '.');
-    }
-    LOGF("\n");
-#else
-    (void)prefix;
-    (void)buffer;
-    (void)size;
-#endif
-}
-
-uint8_t clamp_percent(uint8_t value)
+void protocol_execute(uint8_t command, const uint8_t* payload, uint16_t payload_size)
 {
-    return (value > 100) ? 100 : value;
-}
-
-void send_pong()
-{
-    if (!tud_hid_ready()) {
-        return;
-    }
+    switch (command) {
+    case CMD_SET_COLOR:
+        if (payload_size >= 3) {
+            effects_set_color(payload[0], payload[1], payload[2]);
+            LOGF("SET_COLOR r=%u g=%u b=%u\n", payload[0], payload[1], payload[2]);
+        } else {
+            LOGF("SET_COLOR ignored: payload too small\n");
+        }
+        break;
 
-    uint8_t response[64] = {};
-    memcpy(response, "PONG", 4);
-    tud_hid_report(0, response, sizeof(response));
-}
+    case CMD_OFF:
+        effects_off();
+        LOGF("OFF\n");
+        break;
 
-} // namespace
+    case CMD_SET_MODE:
+        if (payload_size >= 1) {
+            effects_set_mode(payload[0]);
+            LOGF("SET_MODE mode=%u\n", payload[0]);
+        } else {
+            LOGF("SET_MODE ignored: payload too small\n");
+        }
+        break;
 
-void protocol_log_banner()
-{
-    LOGF("\n");
-    LOGF("=== RP2040 ARGB Controller ===\n");
-    LOGF("HID protocol:\n");
-    LOGF("  0xAA = PING\n");
-    LOGF("  0x03 = SET_COLOR (R,G,B)\n");
-    LOGF("  0x04 = OFF\n");
-    LOGF("  0x05 = SET_MODE\n");
-    LOGF("  0x06 = MUSIC_LEVEL (0-255)\n");
-    LOGF("  0x07 = SET_BRIGHTNESS (0-100)\n");
-    LOGF("  0x08 = SET_EFFECT_SPEED (0-100)\n");
-    LOGF("Lighting modes: 0=OFF, 1=STATIC, 2=RAINBOW, 3=BREATHING, 4=CHASE, 5=MUSIC_VU, 6=COLOR_CYCLE\n");
-    LOGF("Main params: WS2812 GPIO=%u, debug LED GPIO=%u, LEDs=%u, gamma=%u\n",
-        WS2812_PIN, DEBUG_LED_PIN, NUM_LEDS, ENABLE_GAMMA);
-}
+    case CMD_MUSIC_LEVEL:
+        if (payload_size >= 1) {
+            effects_set_music_level(payload[0]);
+            LOGF("MUSIC_LEVEL level=%u\n", payload[0]);
+        } else {
+            LOGF("MUSIC_LEVEL ignored: payload too small\n");
+        }
+        break;
 
-} // namespace firmware
+    case CMD_SPECTRUM:
+        if (payload_size >= 1 && payload[0] <= MAX_SPECTRUM_BANDS && payload_size >= 1u + payload[0]) {
+            effects_set_spectrum(&payload[1], payload[0]);
+        } else {
+            LOGF("SPECTRUM ignored: bad band count\n");
+        }
+        break;
 
-uint8_t const* tud_descriptor_device_cb(void)
-{
-    return reinterpret_cast<uint8_t const*>(&firmware::device_descriptor);
-}
+    case CMD_SET_LAYER:
+        if (payload_size >= 8) {
+            const uint16_t start = read_u16(&payload[4]);
+            const uint16_t length = read_u16(&payload[6]);
+            const bool ok = effects_set_layer(payload[0], payload[1], payload[2], payload[3], start, length);
+            LOGF("SET_LAYER layer=%u mode=%u blend=%u opacity=%u start=%u length=%u%s\n", payload[0], payload[1],
+                payload[2], payload[3], start, length, ok ? "" : " rejected");
+        } else {
+            LOGF("SET_LAYER ignored: payload too small\n");
+        }
+        break;
 
-uint8_t const* tud_descriptor_configuration_cb(uint8_t index)
-{
-    (void)index;
-    return firmware::configuration_descriptor;
-}
+    case CMD_SET_ZONE:
+        if (payload_size >= 13) {
+            ZoneConfig zone = {};
+            zone.mode = payload[1];
+            zone.start = read_u16(&payload[2]);
+            zone.length = read_u16(&payload[4]);
+            zone.flags = payload[6];
+            zone.repeat = payload[7];
+            zone.rotation = payload[8];
+            zone.color = {payload[9], payload[10], payload[11]};
+            zone.speed = payload[12];
+            const bool ok = effects_set_zone(payload[0], zone);
+            LOGF("SET_ZONE layer=%u mode=%u start=%u length=%u flags=0x%02X repeat=%u rotation=%u%s\n", payload[0],
+                zone.mode, zone.start, zone.length, zone.flags, zone.repeat, zone.rotation, ok ? "" : " rejected");
+        } else {
+            LOGF("SET_ZONE ignored: payload too small\n");
+        }
+        break;
 
-uint16_t const* tud_descriptor_string_cb(uint8_t index, uint16_t langid)
-{
-    (void)langid;
+    case CMD_ANIMATION_BEGIN:
+        if (payload_size >= 5) {
+            const uint32_t size = read_u32(&payload[1]);
+            const bool ok = animation_begin(payload[0], size);
+            LOGF("ANIMATION_BEGIN target=%u size=%lu%s\n", payload[0], static_cast<unsigned long>(size),
+                ok ? "" : " rejected");
+        } else {
+            LOGF("ANIMATION_BEGIN ignored: payload too small\n");
+        }
+        break;
 
-    uint8_t chr_count = 0;
-    if (index == 0) {
-        firmware::string_descriptor[1] = 0x0409;
-        chr_count = 1;
-    } else {
-        if (index >= sizeof(firmware::string_descriptors) / sizeof(firmware::string_descriptors[0])) {
-            return nullptr;
+    case CMD_ANIMATION_DATA:
+        if (payload_size >= 4 && !animation_write(read_u32(payload), &payload[4], payload_size - 4)) {
+            LOGF("ANIMATION_DATA offset=%lu rejected\n", static_cast<unsigned long>(read_u32(payload)));
         }
+        break;
 
-        const char* str = firmware::string_descriptors[index];
-        chr_count = static_cast<uint8_t>(strlen(str));
-        if (chr_count > 31) {
-            chr_count = 31;
+    case CMD_ANIMATION_END:
+        if (payload_size >= 4 && animation_end(read_u32(payload))) {
+            LOGF("ANIMATION_END: playing\n");
+            effects_set_mode(EFFECT_MODE_ANIMATION);
+        } else {
+            LOGF("ANIMATION_END rejected\n");
         }
-        for (uint8_t i = 0; i < chr_count; i++) {
-            firmware::string_descriptor[1 + i] = static_cast<uint16_t>(str[i]);
+        break;
+
+    case CMD_PROGRAM_DATA:
+        if (payload_size >= 2 && !program_write(read_u16(payload), &payload[2], payload_size - 2)) {
+            LOGF("PROGRAM_DATA offset=%u rejected\n", read_u16(payload));
         }
-    }
+        break;
 
-    firmware::string_descriptor[0] = static_cast<uint16_t>((TUSB_DESC_STRING << 8) | (2 * chr_count + 2));
-    return firmware::string_descriptor;
-}
+    case CMD_PROGRAM_LOAD:
+        if (payload_size >= 2 && program_load(read_u16(payload))) {
+            LOGF("PROGRAM_LOAD size=%u: running\n", read_u16(payload));
+            effects_set_mode(EFFECT_MODE_PROGRAM);
+        } else {
+            LOGF("PROGRAM_LOAD rejected\n");
+        }
+        break;
 
-uint8_t const* tud_hid_descriptor_report_cb(uint8_t instance)
-{
-    (void)instance;
-    return firmware::hid_report_descriptor;
-}
+    case CMD_SET_BRIGHTNESS:
+        if (payload_size >= 1) {
+            const uint8_t brightness = clamp_percent(payload[0]);
+            led_set_brightness(brightness);
+            led_show();
+            LOGF("SET_BRIGHTNESS brightness=%u\n", brightness);
+        } else {
+            LOGF("SET_BRIGHTNESS ignored: payload too small\n");
+        }
+        break;
 
-uint16_t tud_hid_get_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_t report_type, uint8_t* buffer, uint16_t reqlen)
-{
-    (void)instance;
-    (void)report_id;
-    (void)report_type;
-    memset(buffer, 0, reqlen);
-    return reqlen;
-}
+    case CMD_SET_EFFECT_SPEED:
+        if (payload_size >= 1) {
+            effects_set_speed(clamp_percent(payload[0]));
+            LOGF("SET_EFFECT_SPEED speed=%u\n", effect_speed);
+        } else {
+            LOGF("SET_EFFECT_SPEED ignored: payload too small\n");
+        }
+        break;
 
-void tud_hid_set_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_t report_type, uint8_t const* buffer, uint16_t bufsize)
-{
-    (void)instance;
-    (void)report_id;
-    (void)report_type;
-
-    firmware::debug_buffer("HID SET_REPORT", buffer, bufsize);
-    const firmware::ParsedHidCommand parsed = firmware::parse_hid_command(buffer, bufsize);
-    if (parsed.payload == nullptr && parsed.command == 0) {
-        LOGF("Empty HID report\n");
-        return;
-    }
+    case CMD_SET_MUSIC_STYLE:
+        if (payload_size >= 1) {
+            effects_set_music_style(payload[0]);
+            LOGF("SET_MUSIC_STYLE style=%u\n", payload[0]);
+        } else {
+            LOGF("SET_MUSIC_STYLE ignored: payload too small\n");
+        }
+        break;
 
-    firmware::debug_blink(1, 20);
+    case CMD_SET_LED_COUNT:
+        if (payload_size >= 2) {
+            effects_set_led_count(read_u16(payload));
+            LOGF("SET_LED_COUNT count=%u\n", led_get_count());
+        } else {
+            LOGF("SET_LED_COUNT ignored: payload too small\n");
+        }
+        break;
 
-    switch (parsed.command) {
-    case firmware::CMD_SET_COLOR:
-        if (parsed.payload_size >= 3) {
-            firmware::effects_set_color(parsed.payload[0], parsed.payload[1], parsed.payload[2]);
-            LOGF("SET_COLOR r=%u g=%u b=%u\n", parsed.payload[0], parsed.payload[1], parsed.payload[2]);
+    case CMD_SET_OUTPUT:
+        if (payload_size >= 5) {
+            const uint8_t output = payload[0];
+            const uint16_t start = read_u16(&payload[1]);
+            const uint16_t length = read_u16(&payload[3]);
+            const bool ok = led_set_output(output, start, length);
+            LOGF("SET_OUTPUT output=%u start=%u length=%u%s\n", output, start, length, ok ? "" : " rejected");
         } else {
-            LOGF("SET_COLOR ignored: payload too small\n");
+            LOGF("SET_OUTPUT ignored: payload too small\n");
         }
         break;
 
-    case firmware::CMD_OFF:
-        firmware::effects_off();
-        LOGF("OFF\n");
+    case CMD_SET_FRAME_RATE:
+        if (payload_size >= 2) {
+            const bool ok = effects_set_frame_rate(read_u16(payload));
+            LOGF("SET_FRAME_RATE fps=%u%s\n", read_u16(payload), ok ? "" : " rejected");
+        } else {
+            LOGF("SET_FRAME_RATE ignored: payload too small\n");
+        }
         break;
 
-    case firmware::CMD_SET_MODE:
-        if (parsed.payload_size >= 1) {
-            firmware::effects_set_mode(parsed.payload[0]);
-            LOGF("SET_MODE mode=%u\n", parsed.payload[0]);
+    case CMD_SET_OUTPUT_FORMAT:
+        if (payload_size >= 2) {
+            const bool ok = led_set_output_format(payload[0], payload[1]);
+            if (ok) {
+                led_show();
+            }
+            LOGF("SET_OUTPUT_FORMAT output=%u format=%u%s\n", payload[0], payload[1], ok ? "" : " rejected");
         } else {
-            LOGF("SET_MODE ignored: payload too small\n");
+            LOGF("SET_OUTPUT_FORMAT ignored: payload too small\n");
         }
         break;
 
-    case firmware::CMD_MUSIC_LEVEL:
-        if (parsed.payload_size >= 1) {
-            firmware::effects_set_music_level(parsed.payload[0]);
-            LOGF("MUSIC_LEVEL level=%u\n", parsed.payload[0]);
+    case CMD_SET_CALIBRATION:
+        if (payload_size >= 6) {
+            const ColorCalibration calibration = {
+                {payload[0], payload[1], payload[2]},
+                {payload[3], payload[4], payload[5]},
+            };
+            const bool ok = led_set_calibration(calibration);
+            if (ok) {
+                led_show();
+            }
+            LOGF("SET_CALIBRATION gain=%u,%u,%u gamma=%u,%u,%u%s\n", payload[0], payload[1], payload[2], payload[3],
+                payload[4], payload[5], ok ? "" : " rejected");
         } else {
-            LOGF("MUSIC_LEVEL ignored: payload too small\n");
+            LOGF("SET_CALIBRATION ignored: payload too small\n");
         }
         break;
 
-    case firmware::CMD_SET_BRIGHTNESS:
-        if (parsed.payload_size >= 1) {
-            const uint8_t brightness = firmware::clamp_percent(parsed.payload[0]);
-            firmware::led_set_brightness(brightness);
-            firmware::led_show();
-            LOGF("SET_BRIGHTNESS brightness=%u\n", brightness);
+    case CMD_SET_POWER_LIMIT:
+        if (payload_size >= 2) {
+            PowerModel model = led_get_power_model();
+            model.budget_ma = read_u16(payload);
+            if (payload_size >= 6) {
+                model.channel_ma[0] = payload[2];
+                model.channel_ma[1] = payload[3];
+                model.channel_ma[2] = payload[4];
+                model.idle_tenths_ma = payload[5];
+            }
+            led_set_power_model(model);
+            LOGF("SET_POWER_LIMIT budget=%umA channel=%u,%u,%umA idle=%u/10mA\n", model.budget_ma,
+                model.channel_ma[0], model.channel_ma[1], model.channel_ma[2], model.idle_tenths_ma);
         } else {
-            LOGF("SET_BRIGHTNESS ignored: payload too small\n");
+            LOGF("SET_POWER_LIMIT ignored: payload too small\n");
         }
         break;
 
-    case firmware::CMD_SET_EFFECT_SPEED:
-        if (parsed.payload_size >= 1) {
-            firmware::effects_set_speed(firmware::clamp_percent(parsed.payload[0]));
-            LOGF("SET_EFFECT_SPEED speed=%u\n", firmware::effect_speed);
+    case CMD_SET_DITHER:
+        if (payload_size >= 1) {
+            led_set_dither(payload[0] != 0);
+            LOGF("SET_DITHER enabled=%u\n", payload[0] != 0);
         } else {
-            LOGF("SET_EFFECT_SPEED ignored: payload too small\n");
+            LOGF("SET_DITHER ignored: payload too small\n");
         }
         break;
 
-    case firmware::CMD_SET_MUSIC_STYLE:
-        if (parsed.payload_size >= 1) {
-            firmware::effects_set_music_style(parsed.payload[0]);
-            LOGF("SET_MUSIC_STYLE style=%u\n", parsed.payload[0]);
+    case CMD_DIRECT_PIXELS:
+        if (payload_size >= 3 && payload_size >= 3u + (payload[2] * 3u)) {
+            effects_direct_write(read_u16(payload), &payload[3], payload[2]);
         } else {
-            LOGF("SET_MUSIC_STYLE ignored: payload too small\n");
+            LOGF("DIRECT_PIXELS ignored: payload too small\n");
         }
         break;
 
-    case firmware::CMD_PING:
-        firmware::send_pong();
-        LOGF("PING -> PONG\n");
+    case CMD_DIRECT_COMMIT:
+        effects_direct_commit();
+        break;
+
+    case CMD_BATCH:
+        execute_batch(payload, payload_size);
+        break;
+
+    case CMD_INTERNAL_USB_MOUNTED:
+        settings_resume();
+        effects_request_connection();
+        LOGF("USB mounted\n");
+        break;
+
+    case CMD_INTERNAL_USB_UNMOUNTED:
+        // Going dark with the host is not a setting; the stored state returns on mount.
+        settings_suspend();
+        effects_off();
+        LOGF("USB unmounted\n");
+        break;
+
+    case CMD_INTERNAL_DIRECT_FRAME:
+        if (payload_size >= 4) {
+            effects_direct_write(read_u16(payload), command_queue_staged(), read_u16(&payload[2]));
+        }
+        command_queue_stage_release();
         break;
 
     default:
-        LOGF("Unknown command 0x%02X\n", parsed.command);
+        LOGF("Unknown command 0x%02X\n", command);
         break;
     }
 }
 
-void tud_mount_cb(void)
+void protocol_process_commands()
 {
-    firmware::usb_connected = true;
-    firmware::effects_request_connection();
-    firmware::debug_blink(2, 40);
-    LOGF("USB mounted\n");
-}
+    if (command_queue_front() == nullptr) {
+        return;
+    }
 
-void tud_umount_cb(void)
-{
-    firmware::usb_connected = false;
-    firmware::effects_off();
-    LOGF("USB unmounted\n");
+    // Everything queued before this frame lands in a single output, so multi-command
+    // updates never show their intermediate states.
+    led_defer_show(true);
+    while (const HostCommand* queued = command_queue_front()) {
+        protocol_execute(queued->command, queued->payload, queued->payload_size);
+        command_queue_pop();
+    }
+    led_defer_show(false);
 }
 
-bool tud_vendor_control_xfer_cb(uint8_t rhport, uint8_t stage, tusb_control_request_t const* request)
+void protocol_log_banner()
 {
-    (void)rhport;
-    (void)stage;
-    (void)request;
-    return false;
+    LOGF("\n");
+    LOGF("=== RP2040 ARGB Controller ===\n");
+    LOGF("HID protocol:\n");
+    LOGF("  0xAA = PING\n");
+    LOGF("  0x03 = SET_COLOR (R,G,B)\n");
+    LOGF("  0x04 = OFF\n");
+    LOGF("  0x05 = SET_MODE\n");
+    LOGF("  0x06 = MUSIC_LEVEL (0-255)\n");
+    LOGF("  0x07 = SET_BRIGHTNESS (0-100)\n");
+    LOGF("  0x08 = SET_EFFECT_SPEED (0-100)\n");
+    LOGF("  0x09 = SET_MUSIC_STYLE (0-1)\n");
+    LOGF("  0x0A = SET_LED_COUNT (u16 LE, 1-%u)\n", MAX_LEDS);
+    LOGF("  0x0B = SET_OUTPUT (output 0-%u, start u16 LE, length u16 LE)\n", MAX_OUTPUT_CHANNELS - 1);
+    LOGF("  0x0C = SET_DITHER (0-1)\n");
+    LOGF("  0x10 = DIRECT_PIXELS (offset u16 LE, count, RGB x count)\n");
+    LOGF("  0x11 = DIRECT_COMMIT\n");
+    LOGF("  0x12 = BATCH ([cmd][len][payload] ...)\n");
+    LOGF("  0x13 = GET_TELEMETRY (page 0-%u)\n", TELEMETRY_PAGE_COUNT - 1);
+    LOGF("  0x14 = SPECTRUM (count 0-%u, level x count)\n", MAX_SPECTRUM_BANDS);
+    LOGF("  0x15 = SET_LAYER (layer 0-%u, mode, blend 0-3, opacity, start u16 LE, length u16 LE)\n", MAX_LAYERS - 1);
+    LOGF("  0x16 = SET_ZONE (layer, mode, start u16 LE, length u16 LE, flags, repeat, rotation, R,G,B, speed)\n");
+    LOGF("  0x17 = ANIMATION_BEGIN (target 0=RAM 1=flash, size u32 LE)\n");
+    LOGF("  0x18 = ANIMATION_DATA (offset u32 LE, bytes)\n");
+    LOGF("  0x19 = ANIMATION_END (crc32 u32 LE)\n");
+    LOGF("  0x1A = PROGRAM_DATA (offset u16 LE, code bytes)\n");
+    LOGF("  0x1B = PROGRAM_LOAD (size u16 LE, up to %u instructions)\n", MAX_PROGRAM_INSTRUCTIONS);
+    LOGF("  0x1C = SET_FRAME_RATE (u16 LE: 30, 60, 120 or 240)\n");
+    LOGF("  0x1D = SET_OUTPUT_FORMAT (output, 0=GRB 1=RGB 2=BRG 3=GRBW 4=GRB16)\n");
+    LOGF("  0x1E = SET_CALIBRATION (gain R,G,B, gamma R,G,B in tenths %u-%u)\n", MIN_GAMMA_TENTHS, MAX_GAMMA_TENTHS);
+    LOGF("  0x1F = SET_POWER_LIMIT (budget mA u16 LE, 0=off[, mA R,G,B, idle tenths of mA])\n");
+    LOGF("Lighting modes: 0=OFF, 1=STATIC, 2=RAINBOW, 3=BREATHING, 4=CHASE, 5=MUSIC_VU, 6=COLOR_CYCLE, 7=DIRECT, 8=SPECTRUM_BARS, 9=SPECTRUM, 10=ANIMATION, 11=PROGRAM\n");
+    LOGF("Main params: WS2812 GPIO=%u, debug LED GPIO=%u, LEDs=%u/%u, gamma=%u, fps=%u\n",
+        WS2812_PIN, DEBUG_LED_PIN, led_get_count(), MAX_LEDS, ENABLE_GAMMA, effects_get_frame_rate());
 }
 
-void tud_vendor_rx_cb(uint8_t itf, uint8_t const* buffer, uint16_t bufsize)
-{
-    (void)itf;
-    (void)buffer;
-    (void)bufsize;
-}
+} // namespace firmware
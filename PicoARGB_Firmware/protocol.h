@@ -13,9 +13,69 @@ enum HidCommand : uint8_t {
     CMD_SET_BRIGHTNESS = 0x07,
     CMD_SET_EFFECT_SPEED = 0x08,
     CMD_SET_MUSIC_STYLE = 0x09,
+    CMD_SET_LED_COUNT = 0x0A,
+    CMD_SET_OUTPUT = 0x0B,
+    CMD_SET_DITHER = 0x0C,
+    // Direct mode: offset u16 LE, count, then count x R,G,B. Latched by DIRECT_COMMIT.
+    CMD_DIRECT_PIXELS = 0x10,
+    CMD_DIRECT_COMMIT = 0x11,
+    // Sequence of [command][length][payload] entries applied on one frame boundary.
+    CMD_BATCH = 0x12,
+    // Answered on the USB core with a telemetry page (see telemetry.h), also served by GET_REPORT.
+    CMD_GET_TELEMETRY = 0x13,
+    // Band count, then one level (0-255) per band, lowest frequency first.
+    CMD_SPECTRUM = 0x14,
+    // Layer, mode, blend, opacity, start u16 LE, length u16 LE (0 removes the layer).
+    CMD_SET_LAYER = 0x15,
+    // Layer, mode, start u16 LE, length u16 LE, flags, repeat, rotation, R, G, B, speed.
+    CMD_SET_ZONE = 0x16,
+    // Animation upload (see animation.h): BEGIN target, size u32 LE; DATA offset
+    // u32 LE, then bytes; END crc32 u32 LE, which starts playback when valid.
+    CMD_ANIMATION_BEGIN = 0x17,
+    CMD_ANIMATION_DATA = 0x18,
+    CMD_ANIMATION_END = 0x19,
+    // Per-pixel program upload (see pixel_program.h): DATA offset u16 LE, then code
+    // bytes; LOAD size u16 LE checks the staged code and starts running it.
+    CMD_PROGRAM_DATA = 0x1A,
+    CMD_PROGRAM_LOAD = 0x1B,
+    // Frames per second as u16 LE: 30, 60, 120 or 240.
+    CMD_SET_FRAME_RATE = 0x1C,
+    // Output 0-7, chipset format (PixelFormatId, see pixel_format.h).
+    CMD_SET_OUTPUT_FORMAT = 0x1D,
+    // White-point gain R, G, B (255 = unity), then gamma R, G, B in tenths (10-40).
+    CMD_SET_CALIBRATION = 0x1E,
+    // Power budget in mA as u16 LE (0 = no limit), optionally followed by the current
+    // model: mA per channel R, G, B at full duty and idle draw per LED in tenths of mA.
+    CMD_SET_POWER_LIMIT = 0x1F,
     CMD_PING = 0xAA,
 };
 
+// Events raised by the USB core for the render core. Never accepted from the host.
+enum InternalCommand : uint8_t {
+    CMD_INTERNAL_USB_MOUNTED = 0xF0,
+    CMD_INTERNAL_USB_UNMOUNTED = 0xF1,
+    // A vendor DIRECT_PIXELS frame in the command queue's frame stage: offset u16 LE,
+    // pixel count u16 LE.
+    CMD_INTERNAL_DIRECT_FRAME = 0xF2,
+};
+
+// Vendor bulk stream framing: [0xA5][command][length u16 LE][payload]. Payloads use
+// the HID command layouts, except DIRECT_PIXELS which is offset u16 LE followed by
+// any number of R,G,B triplets, so a whole frame fits in one stream frame.
+constexpr uint8_t VENDOR_FRAME_MAGIC = 0xA5;
+
+struct ParsedHidCommand {
+    uint8_t command = 0;
+    const uint8_t* payload = nullptr;
+    uint16_t payload_size = 0;
+};
+
+ParsedHidCommand protocol_parse_report(const uint8_t* buffer, uint16_t size);
+
+// Applies one command to the effect and LED state. Render core only.
+void protocol_execute(uint8_t command, const uint8_t* payload, uint16_t payload_size);
+void protocol_process_commands();
+
 void protocol_log_banner();
 
 } // namespace firmware
@@ -0,0 +1,272 @@
+#include "settings.h"
+
+#include <stddef.h>
+#include <string.h>
+#include "animation.h"
+#include "config.h"
+#include "crc32.h"
+#include "effects.h"
+#include "hardware/flash.h"
+#include "led_driver.h"
+#include "pico/flash.h"
+
+namespace firmware {
+namespace {
+
+constexpr uint32_t SETTINGS_SECTORS = SETTINGS_FLASH_BYTES / FLASH_SECTOR_SIZE;
+constexpr uint32_t SETTINGS_FLASH_OFFSET = PICO_FLASH_SIZE_BYTES - (SETTINGS_SECTORS * FLASH_SECTOR_SIZE);
+constexpr uint32_t SETTINGS_CHECK_MS = 100;
+constexpr uint32_t SETTINGS_FLASH_TIMEOUT_MS = 100;
+constexpr uint32_t EMPTY_SEQUENCE = 0xFFFFFFFFu;
+
+struct StoredSettings {
+    uint8_t mode;
+    uint8_t brightness;
+    uint8_t speed;
+    uint8_t music_style;
+    uint8_t dither;
+    uint8_t color_set;
+    uint16_t led_count;
+    Rgb color;
+    // Frames per second; 0 in records written before it was stored.
+    uint8_t frame_rate;
+    struct {
+        uint16_t start;
+        uint16_t length;
+    } outputs[MAX_OUTPUT_CHANNELS];
+    // Zero (GRB) in records written before formats were stored.
+    uint8_t output_formats[MAX_OUTPUT_CHANNELS];
+    // Power limiter budget; 0 (no limit) in records written before it was stored.
+    // The current model does not fit the record and starts from the defaults, and
+    // neither does the color calibration, which the host re-sends on connect.
+    uint16_t power_budget_ma;
+};
+
+// Records are smaller than a flash page; the rest of the page is programmed as
+// 0xFF, which leaves the neighbouring records untouched.
+struct SettingsRecord {
+    uint32_t sequence;
+    StoredSettings settings;
+    uint8_t padding[64 - 8 - sizeof(StoredSettings)];
+    uint32_t crc;
+};
+
+static_assert(sizeof(SettingsRecord) == 64, "settings record must stay 64 bytes");
+static_assert(FLASH_PAGE_SIZE % sizeof(SettingsRecord) == 0, "records must not straddle pages");
+
+constexpr uint32_t RECORDS_PER_SECTOR = FLASH_SECTOR_SIZE / sizeof(SettingsRecord);
+
+struct FlashWrite {
+    bool erase;
+    uint32_t sector_offset;
+    uint32_t page_offset;
+    const uint8_t* page;
+};
+
+StoredSettings stored = {};
+StoredSettings last_seen = {};
+bool have_stored = false;
+bool suspended = false;
+bool change_pending = false;
+uint32_t changed_ms = 0;
+uint32_t last_check_ms = 0;
+
+uint32_t last_sequence = 0;
+uint32_t active_sector = SETTINGS_SECTORS - 1;
+// Starting full forces the first write to erase a sector before using it.
+uint32_t next_slot = RECORDS_PER_SECTOR;
+
+uint32_t record_crc(const SettingsRecord& record)
+{
+    return crc32(reinterpret_cast<const uint8_t*>(&record), offsetof(SettingsRecord, crc));
+}
+
+const SettingsRecord* record_at(uint32_t sector, uint32_t slot)
+{
+    const uintptr_t address = XIP_BASE + SETTINGS_FLASH_OFFSET + (sector * FLASH_SECTOR_SIZE)
+        + (slot * sizeof(SettingsRecord));
+    return reinterpret_cast<const SettingsRecord*>(address);
+}
+
+StoredSettings capture()
+{
+    StoredSettings current = {};
+    // Direct mode only lasts while the host streams, programs are not stored, and an
+    // animation only survives a reboot from the flash slot, so otherwise the previous
+    // mode is kept.
+    const uint8_t mode = effects_get_mode();
+    const bool lost_on_reboot = mode == EFFECT_MODE_DIRECT || mode == EFFECT_MODE_PROGRAM
+        || (mode == EFFECT_MODE_ANIMATION && !animation_flash_valid());
+    current.mode = lost_on_reboot ? stored.mode : mode;
+    current.brightness = led_get_brightness();
+    current.speed = effect_speed;
+    current.music_style = effects_get_music_style();
+    current.dither = led_get_dither() ? 1 : 0;
+    current.color_set = effects_get_color(current.color) ? 1 : 0;
+    current.led_count = led_get_count();
+    current.frame_rate = static_cast<uint8_t>(effects_get_frame_rate());
+    for (uint8_t i = 0; i < MAX_OUTPUT_CHANNELS; i++) {
+        led_get_output(i, current.outputs[i].start, current.outputs[i].length);
+        current.output_formats[i] = led_get_output_format(i);
+    }
+    current.power_budget_ma = led_get_power_model().budget_ma;
+    return current;
+}
+
+void apply(const StoredSettings& settings)
+{
+    effects_set_led_count(settings.led_count);
+    for (uint8_t i = 0; i < MAX_OUTPUT_CHANNELS; i++) {
+        led_set_output_format(i, settings.output_formats[i]);
+        led_set_output(i, settings.outputs[i].start, settings.outputs[i].length);
+    }
+    PowerModel power = led_get_power_model();
+    power.budget_ma = settings.power_budget_ma;
+    led_set_power_model(power);
+    led_set_brightness(settings.brightness);
+    led_set_dither(settings.dither != 0);
+    effects_set_speed(settings.speed);
+    effects_set_music_style(settings.music_style);
+    if (settings.frame_rate != 0) {
+        effects_set_frame_rate(settings.frame_rate);
+    }
+    if (settings.color_set != 0) {
+        effects_set_color(settings.color.r, settings.color.g, settings.color.b);
+    }
+    effects_set_mode(settings.mode);
+}
+
+void flash_write(void* param)
+{
+    const FlashWrite* write = static_cast<const FlashWrite*>(param);
+    if (write->erase) {
+        flash_range_erase(write->sector_offset, FLASH_SECTOR_SIZE);
+    }
+    flash_range_program(write->page_offset, write->page, FLASH_PAGE_SIZE);
+}
+
+void write_record(const StoredSettings& settings)
+{
+    FlashWrite write = {false, 0, 0, nullptr};
+    if (next_slot >= RECORDS_PER_SECTOR) {
+        // Compaction: the newest state is the only record the fresh sector needs.
+        active_sector = (active_sector + 1) % SETTINGS_SECTORS;
+        next_slot = 0;
+        write.erase = true;
+    }
+    write.sector_offset = SETTINGS_FLASH_OFFSET + (active_sector * FLASH_SECTOR_SIZE);
+
+    SettingsRecord record = {};
+    record.sequence = last_sequence + 1;
+    record.settings = settings;
+    record.crc = record_crc(record);
+
+    constexpr uint32_t RECORDS_PER_PAGE = FLASH_PAGE_SIZE / sizeof(SettingsRecord);
+    uint8_t page[FLASH_PAGE_SIZE];
+    memset(page, 0xFF, sizeof(page));
+    memcpy(&page[(next_slot % RECORDS_PER_PAGE) * sizeof(SettingsRecord)], &record, sizeof(record));
+    write.page_offset = write.sector_offset + ((next_slot / RECORDS_PER_PAGE) * FLASH_PAGE_SIZE);
+    write.page = page;
+
+    const int result = flash_safe_execute(flash_write, &write, SETTINGS_FLASH_TIMEOUT_MS);
+    if (result != PICO_OK) {
+        LOGF("Settings write failed (%d)\n", result);
+        return;
+    }
+
+    next_slot++;
+    last_sequence = record.sequence;
+    stored = settings;
+    have_stored = true;
+    LOGF("Settings saved seq=%lu sector=%lu slot=%lu\n", static_cast<unsigned long>(last_sequence),
+        static_cast<unsigned long>(active_sector), static_cast<unsigned long>(next_slot - 1));
+}
+
+} // namespace
+
+void settings_load()
+{
+    const SettingsRecord* newest = nullptr;
+    uint32_t newest_sector = 0;
+    for (uint32_t sector = 0; sector < SETTINGS_SECTORS; sector++) {
+        for (uint32_t slot = 0; slot < RECORDS_PER_SECTOR; slot++) {
+            const SettingsRecord* record = record_at(sector, slot);
+            if (record->sequence == EMPTY_SEQUENCE || record->crc != record_crc(*record)) {
+                continue;
+            }
+            if (newest == nullptr || record->sequence > newest->sequence) {
+                newest = record;
+                newest_sector = sector;
+            }
+        }
+    }
+
+    if (newest == nullptr) {
+        // Start the log afresh, as on a blank chip.
+        last_sequence = 0;
+        active_sector = SETTINGS_SECTORS - 1;
+        next_slot = RECORDS_PER_SECTOR;
+        have_stored = false;
+        stored = capture();
+        last_seen = stored;
+        LOGF("Settings: none stored, using defaults\n");
+        return;
+    }
+
+    // Append after the last used slot, valid or not, so a torn write is never reused.
+    active_sector = newest_sector;
+    next_slot = RECORDS_PER_SECTOR;
+    while (next_slot > 0 && record_at(active_sector, next_slot - 1)->sequence == EMPTY_SEQUENCE) {
+        next_slot--;
+    }
+    last_sequence = newest->sequence;
+    stored = newest->settings;
+    have_stored = true;
+    apply(stored);
+    last_seen = capture();
+    LOGF("Settings loaded seq=%lu mode=%u brightness=%u leds=%u\n", static_cast<unsigned long>(last_sequence),
+        stored.mode, stored.brightness, stored.led_count);
+}
+
+void settings_service(uint32_t now_ms)
+{
+    if (suspended || (now_ms - last_check_ms) < SETTINGS_CHECK_MS) {
+        return;
+    }
+    last_check_ms = now_ms;
+
+    const StoredSettings current = capture();
+    if (memcmp(&current, &last_seen, sizeof(current)) != 0) {
+        last_seen = current;
+        changed_ms = now_ms;
+        change_pending = true;
+        return;
+    }
+
+    if (change_pending && (now_ms - changed_ms) >= SETTINGS_WRITE_DELAY_MS) {
+        change_pending = false;
+        if (!have_stored || memcmp(&current, &stored, sizeof(current)) != 0) {
+            write_record(current);
+        }
+    }
+}
+
+void settings_suspend()
+{
+    suspended = true;
+    change_pending = false;
+}
+
+void settings_resume()
+{
+    if (!suspended) {
+        return;
+    }
+    suspended = false;
+    if (have_stored) {
+        apply(stored);
+    }
+    last_seen = capture();
+}
+
+} // namespace firmware
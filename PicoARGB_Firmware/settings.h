@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stdint.h>
+
+namespace firmware {
+
+// Persistent lighting state (mode, color, brightness, speed, music style, dither,
+// LED count, output segments and formats, frame rate and power budget), kept as an
+// append-only log in the last two flash sectors. The color calibration and the
+// power model are not stored. Runs on the render core.
+void settings_load();
+// Watches the live state and writes it once it has been stable for
+// SETTINGS_WRITE_DELAY_MS, so a slider drag costs one record.
+void settings_service(uint32_t now_ms);
+// While suspended (USB unmounted) changes are not persisted; resuming re-applies
+// the stored state.
+void settings_suspend();
+void settings_resume();
+
+} // namespace firmware
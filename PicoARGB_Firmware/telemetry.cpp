@@ -0,0 +1,150 @@
+#include "telemetry.h"
+
+#include <string.h>
+#include "command_queue.h"
+#include "config.h"
+#include "effects.h"
+#include "protocol.h"
+
+namespace firmware {
+namespace {
+
+struct TimingStats {
+    uint32_t samples = 0;
+    uint32_t min_us = UINT32_MAX;
+    uint32_t max_us = 0;
+    uint64_t total_us = 0;
+    uint32_t histogram[TELEMETRY_HISTOGRAM_BUCKETS] = {};
+};
+
+TimingStats timing[TELEMETRY_SECTION_COUNT];
+volatile uint32_t frames_rendered = 0;
+volatile uint32_t frames_late = 0;
+volatile uint32_t outputs_skipped = 0;
+volatile uint32_t frames_skipped = 0;
+volatile uint32_t power_estimated_ma = 0;
+volatile uint32_t power_scale = 65536;
+volatile uint32_t hid_reports = 0;
+volatile uint32_t vendor_frames = 0;
+
+uint8_t histogram_bucket(uint32_t elapsed_us)
+{
+    uint32_t scaled = elapsed_us >> TELEMETRY_HISTOGRAM_SHIFT;
+    uint8_t bucket = 0;
+    while (scaled != 0 && bucket < TELEMETRY_HISTOGRAM_BUCKETS - 1) {
+        scaled >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+void put_u16(uint8_t* out, uint32_t value)
+{
+    const uint32_t clamped = (value > 0xFFFFu) ? 0xFFFFu : value;
+    out[0] = static_cast<uint8_t>(clamped);
+    out[1] = static_cast<uint8_t>(clamped >> 8);
+}
+
+void put_u32(uint8_t* out, uint32_t value)
+{
+    out[0] = static_cast<uint8_t>(value);
+    out[1] = static_cast<uint8_t>(value >> 8);
+    out[2] = static_cast<uint8_t>(value >> 16);
+    out[3] = static_cast<uint8_t>(value >> 24);
+}
+
+} // namespace
+
+void telemetry_record(TelemetrySection section, uint32_t started_us)
+{
+    const uint32_t elapsed_us = time_us_32() - started_us;
+    TimingStats& stats = timing[section];
+    stats.samples++;
+    stats.total_us += elapsed_us;
+    if (elapsed_us < stats.min_us) {
+        stats.min_us = elapsed_us;
+    }
+    if (elapsed_us > stats.max_us) {
+        stats.max_us = elapsed_us;
+    }
+    stats.histogram[histogram_bucket(elapsed_us)]++;
+}
+
+void telemetry_count_frame(bool late)
+{
+    frames_rendered = frames_rendered + 1;
+    if (late) {
+        frames_late = frames_late + 1;
+    }
+}
+
+void telemetry_count_output_skipped()
+{
+    outputs_skipped = outputs_skipped + 1;
+}
+
+void telemetry_count_frames_skipped(uint32_t count)
+{
+    frames_skipped = frames_skipped + count;
+}
+
+void telemetry_count_hid_report()
+{
+    hid_reports = hid_reports + 1;
+}
+
+void telemetry_count_vendor_frame()
+{
+    vendor_frames = vendor_frames + 1;
+}
+
+void telemetry_record_power(uint32_t estimated_ma, uint32_t scale)
+{
+    power_estimated_ma = estimated_ma;
+    power_scale = scale;
+}
+
+uint16_t telemetry_write_report(uint8_t page, uint8_t* buffer, uint16_t size)
+{
+    uint8_t report[64] = {};
+    report[0] = CMD_GET_TELEMETRY;
+    report[1] = page;
+
+    if (page == TELEMETRY_PAGE_SUMMARY) {
+        put_u32(&report[2], frames_rendered);
+        put_u32(&report[6], frames_late);
+        put_u32(&report[10], command_queue_dropped());
+
+        uint8_t* out = &report[14];
+        for (const TimingStats& stats : timing) {
+            const uint32_t samples = stats.samples;
+            put_u32(&out[0], samples);
+            put_u16(&out[4], (samples == 0) ? 0 : stats.min_us);
+            put_u16(&out[6], (samples == 0) ? 0 : static_cast<uint32_t>(stats.total_us / samples));
+            put_u16(&out[8], stats.max_us);
+            out += 10;
+        }
+        put_u32(&out[0], outputs_skipped);
+        put_u32(&out[4], frames_skipped);
+        put_u16(&out[8], effects_get_frame_rate());
+        put_u16(&out[10], power_estimated_ma);
+        put_u16(&out[12], (power_scale * 1000u + 32768u) >> 16);
+    } else if (page == TELEMETRY_PAGE_USB_RX) {
+        put_u32(&report[2], hid_reports);
+        put_u32(&report[6], vendor_frames);
+    } else if (page < TELEMETRY_PAGE_COUNT) {
+        const TimingStats& stats = timing[page - 1];
+        for (uint8_t i = 0; i < TELEMETRY_HISTOGRAM_BUCKETS; i++) {
+            put_u32(&report[2 + i * 4], stats.histogram[i]);
+        }
+    }
+
+    const uint16_t length = (size < sizeof(report)) ? size : sizeof(report);
+    memcpy(buffer, report, length);
+    if (size > length) {
+        memset(buffer + length, 0, size - length);
+    }
+    return size;
+}
+
+} // namespace firmware
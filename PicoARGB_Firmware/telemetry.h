@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdint.h>
+
+namespace firmware {
+
+// Frame-timing counters. Render and output are recorded on core 1, USB handling on
+// core 0; each section is written by one core only, and the report is read on core
+// 0, so a sample landing mid-read can at worst skew one report.
+//
+// Sections are timed with the 1 MHz system timer (time_us_32()), not in clk_sys
+// cycles: the render core lowers clk_sys while idle, so cycle counts from SysTick
+// would change scale between samples, and the sections run for tens of
+// microseconds or more, so 1 us resolution is enough for min/avg/max.
+enum TelemetrySection : uint8_t {
+    TELEMETRY_RENDER = 0,
+    TELEMETRY_OUTPUT = 1,
+    TELEMETRY_USB = 2,
+    TELEMETRY_SECTION_COUNT,
+};
+
+// Histogram bucket n counts samples below 128 << n microseconds; the last bucket
+// also takes everything above.
+constexpr uint8_t TELEMETRY_HISTOGRAM_BUCKETS = 8;
+constexpr uint8_t TELEMETRY_HISTOGRAM_SHIFT = 7;
+
+// Pages of the GET_TELEMETRY report.
+//   0: [cmd][0][frames u32][late u32][dropped u32] then per section
+//      [samples u32][min u16][avg u16][max u16], then [skipped outputs u32]
+//      [skipped frames u32][frame rate u16][estimated mA u16][power scale u16,
+//      per mille]; all little endian, times in us.
+//   1..3: [cmd][page][bucket u32 x 8] for section page - 1.
+//   4: [cmd][page][HID reports u32][vendor frames u32] received since boot.
+constexpr uint8_t TELEMETRY_PAGE_SUMMARY = 0;
+constexpr uint8_t TELEMETRY_PAGE_USB_RX = 1 + TELEMETRY_SECTION_COUNT;
+constexpr uint8_t TELEMETRY_PAGE_COUNT = TELEMETRY_PAGE_USB_RX + 1;
+
+void telemetry_record(TelemetrySection section, uint32_t started_us);
+void telemetry_count_frame(bool late);
+void telemetry_count_output_skipped();
+// Frame deadlines that passed without a frame being rendered.
+void telemetry_count_frames_skipped(uint32_t count);
+// Host->device traffic, counted on core 0. HID reports are counted together whether
+// they came over the interrupt OUT endpoint or as control SET_REPORTs: the stack
+// does not tag them reliably, and the host knows which pipe it writes to.
+void telemetry_count_hid_report();
+void telemetry_count_vendor_frame();
+// Estimated draw of the last frame sent and the power limiter's scale (Q16).
+void telemetry_record_power(uint32_t estimated_ma, uint32_t scale);
+uint16_t telemetry_write_report(uint8_t page, uint8_t* buffer, uint16_t size);
+
+} // namespace firmware
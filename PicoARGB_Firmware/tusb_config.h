@@ -110,8 +110,10 @@
 // HID buffer size - aumentado para datos RGB
 #define CFG_TUD_HID_EP_BUFSIZE    64
 
-// Vendor class buffer size
-#define CFG_TUD_VENDOR_RX_BUFSIZE 64
+// Vendor class: bulk stream for direct pixel frames. The RX FIFO holds about a
+// full 600-LED frame so the host can keep the bulk pipe busy.
+#define CFG_TUD_VENDOR_EPSIZE     64
+#define CFG_TUD_VENDOR_RX_BUFSIZE 2048
 #define CFG_TUD_VENDOR_TX_BUFSIZE 64
 
 // CDC ring buffer sizes and endpoint buffer size
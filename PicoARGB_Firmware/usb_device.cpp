@@ -0,0 +1,552 @@
+#include "usb_device.h"
+
+#include <string.h>
+#include "command_queue.h"
+#include "config.h"
+#include "protocol.h"
+#include "telemetry.h"
+#include "tusb.h"
+
+// USB device stack glue. Runs on core 0 from tud_task(); commands are only decoded
+// here and handed to the render core through the command queue.
+namespace firmware {
+namespace {
+
+uint16_t string_descriptor[32];
+
+uint8_t const hid_report_descriptor[] = {
+    0x06, 0x00, 0xFF, 0x09, 0x01, 0xA1, 0x01,
+    0x15, 0x00, 0x26, 0xFF, 0x00,
+    0x75, 0x08, 0x95, 0x40,
+    0x09, 0x01, 0x81, 0x02,
+    0x09, 0x01, 0x91, 0x02,
+    0xC0
+};
+
+tusb_desc_device_t const device_descriptor = {
+    .bLength = sizeof(tusb_desc_device_t),
+    .bDescriptorType = TUSB_DESC_DEVICE,
+    .bcdUSB = 0x0210,
+    .bDeviceClass = 0x00,
+    .bDeviceSubClass = 0x00,
+    .bDeviceProtocol = 0x00,
+    .bMaxPacketSize0 = 64,
+    .idVendor = USB_VID,
+    .idProduct = USB_PID,
+    .bcdDevice = 0x0100,
+    .iManufacturer = 0x01,
+    .iProduct = 0x02,
+    .iSerialNumber = 0x03,
+    .bNumConfigurations = 0x01,
+};
+
+enum {
+    ITF_NUM_HID,
+    ITF_NUM_VENDOR,
+    ITF_TOTAL,
+};
+
+// Host->device reports use the interrupt OUT endpoint; hosts that still send
+// SET_REPORT over the control pipe are handled by the same callback.
+constexpr uint8_t EPNUM_HID_OUT = 0x01;
+constexpr uint8_t EPNUM_HID_IN = 0x81;
+constexpr uint8_t HID_POLL_INTERVAL_MS = 1;
+constexpr uint8_t EPNUM_VENDOR_OUT = 0x02;
+constexpr uint8_t EPNUM_VENDOR_IN = 0x82;
+constexpr uint16_t CONFIG_TOTAL_LEN = TUD_CONFIG_DESC_LEN + TUD_HID_INOUT_DESC_LEN + TUD_VENDOR_DESC_LEN;
+
+uint8_t const configuration_descriptor[] = {
+    TUD_CONFIG_DESCRIPTOR(1, ITF_TOTAL, 0, CONFIG_TOTAL_LEN, TUSB_DESC_CONFIG_ATT_REMOTE_WAKEUP, 100),
+    TUD_HID_INOUT_DESCRIPTOR(ITF_NUM_HID, 4, HID_ITF_PROTOCOL_NONE, sizeof(hid_report_descriptor),
+        EPNUM_HID_OUT, EPNUM_HID_IN, 64, HID_POLL_INTERVAL_MS),
+    TUD_VENDOR_DESCRIPTOR(ITF_NUM_VENDOR, 5, EPNUM_VENDOR_OUT, EPNUM_VENDOR_IN, 64),
+};
+
+// MS OS 2.0 descriptors bind WinUSB to the vendor interface without an INF.
+constexpr uint8_t VENDOR_REQUEST_MICROSOFT = 1;
+constexpr uint16_t MS_OS_20_DESC_LEN = 0xB2;
+constexpr uint16_t BOS_TOTAL_LEN = TUD_BOS_DESC_LEN + TUD_BOS_MICROSOFT_OS_DESC_LEN;
+
+uint8_t const bos_descriptor[] = {
+    TUD_BOS_DESCRIPTOR(BOS_TOTAL_LEN, 1),
+    TUD_BOS_MS_OS_20_DESCRIPTOR(MS_OS_20_DESC_LEN, VENDOR_REQUEST_MICROSOFT),
+};
+
+uint8_t const ms_os_20_descriptor[] = {
+    // Set header: length, type, Windows version, total length.
+    U16_TO_U8S_LE(0x000A), U16_TO_U8S_LE(MS_OS_20_SET_HEADER_DESCRIPTOR), U32_TO_U8S_LE(0x06030000), U16_TO_U8S_LE(MS_OS_20_DESC_LEN),
+    // Configuration subset header: length, type, configuration index, reserved, subset length.
+    U16_TO_U8S_LE(0x0008), U16_TO_U8S_LE(MS_OS_20_SUBSET_HEADER_CONFIGURATION), 0, 0, U16_TO_U8S_LE(MS_OS_20_DESC_LEN - 0x0A),
+    // Function subset header: length, type, first interface, reserved, subset length.
+    U16_TO_U8S_LE(0x0008), U16_TO_U8S_LE(MS_OS_20_SUBSET_HEADER_FUNCTION), ITF_NUM_VENDOR, 0, U16_TO_U8S_LE(MS_OS_20_DESC_LEN - 0x0A - 0x08),
+    // Compatible ID: WINUSB.
+    U16_TO_U8S_LE(0x0014), U16_TO_U8S_LE(MS_OS_20_FEATURE_COMPATBLE_ID), 'W', 'I', 'N', 'U', 'S', 'B', 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    // Registry property DeviceInterfaceGUIDs (REG_MULTI_SZ).
+    U16_TO_U8S_LE(MS_OS_20_DESC_LEN - 0x0A - 0x08 - 0x08 - 0x14), U16_TO_U8S_LE(MS_OS_20_FEATURE_REG_PROPERTY),
+    U16_TO_U8S_LE(0x0007), U16_TO_U8S_LE(0x002A),
+    'D', 0x00, 'e', 0x00, 'v', 0x00, 'i', 0x00, 'c', 0x00, 'e', 0x00, 'I', 0x00, 'n', 0x00,
+    't', 0x00, 'e', 0x00, 'r', 0x00, 'f', 0x00, 'a', 0x00, 'c', 0x00, 'e', 0x00, 'G', 0x00,
+    'U', 0x00, 'I', 0x00, 'D', 0x00, 's', 0x00, 0x00, 0x00,
+    U16_TO_U8S_LE(0x0050),
+    '{', 0x00, '3', 0x00, 'F', 0x00, '6', 0x00, 'A', 0x00, '2', 0x00, 'B', 0x00, '1', 0x00,
+    'E', 0x00, '-', 0x00, '9', 0x00, 'C', 0x00, '4', 0x00, 'D', 0x00, '-', 0x00, '4', 0x00,
+    'E', 0x00, '8', 0x00, 'A', 0x00, '-', 0x00, 'B', 0x00, '7', 0x00, 'F', 0x00, '2', 0x00,
+    '-', 0x00, '5', 0x00, 'D', 0x00, '1', 0x00, 'C', 0x00, '0', 0x00, 'A', 0x00, '9', 0x00,
+    'E', 0x00, '6', 0x00, 'B', 0x00, '4', 0x00, '3', 0x00, '}', 0x00, 0x00, 0x00, 0x00, 0x00,
+};
+
+static_assert(sizeof(ms_os_20_descriptor) == MS_OS_20_DESC_LEN, "MS OS 2.0 descriptor length mismatch");
+
+const char* const string_descriptors[] = {
+    nullptr,
+    "OpenRGB Project",
+    "Pico ARGB Controller",
+    "PICO-AR12-001",
+    "HID Interface",
+    "Vendor Stream",
+};
+
+// Vendor bulk stream parser. DIRECT_PIXELS frames are read from the TinyUSB FIFO
+// straight into the command queue's frame stage and handed to the render core with
+// one queued command once complete; other frames go straight into a queue slot.
+// While the stage or the queue is busy the data stays in the FIFO and the endpoint
+// NAKs, so a fast host is throttled instead of losing frames.
+struct VendorStream {
+    uint8_t header[4];
+    uint8_t header_size;
+    uint8_t command;
+    uint16_t remaining;
+    uint16_t pixel_offset;
+    // Pixels of the frame that fit the LED buffer, and how many bytes of them are staged.
+    uint16_t stage_pixels;
+    uint16_t staged_bytes;
+    bool offset_read;
+    bool discarding;
+};
+
+VendorStream vendor_stream = {};
+
+// Mount state change that found the command queue full, latched until a slot frees up.
+// Only the latest one matters: the render core resumes or suspends to match it.
+uint8_t pending_usb_event = 0;
+
+void debug_buffer(const char* prefix, const uint8_t* buffer, uint16_t size)
+{
+#if DEBUG_LOG
+    LOGF("%s size=%u hex=", prefix, size);
+    for (uint16_t i = 0; i < size && i < 32; i++) {
+        LOGF("%02X ", buffer[i]);
+    }
+    LOGF("ascii=");
+    for (uint16_t i = 0; i < size && i < 32; i++) {
+        LOGF("%c", (buffer[i] >= 32 && buffer[i] <= 126) ? buffer[i] : '.');
+    }
+    LOGF("\n");
+#else
+    (void)prefix;
+    (void)buffer;
+    (void)size;
+#endif
+}
+
+void send_pong()
+{
+    if (!tud_hid_ready()) {
+        return;
+    }
+
+    uint8_t response[64] = {};
+    memcpy(response, "PONG", 4);
+    tud_hid_report(0, response, sizeof(response));
+}
+
+// Page of the telemetry report returned by GET_REPORT, selected by the last GET_TELEMETRY.
+uint8_t telemetry_page = TELEMETRY_PAGE_SUMMARY;
+
+void send_telemetry()
+{
+    if (!tud_hid_ready()) {
+        return;
+    }
+
+    uint8_t response[64];
+    telemetry_write_report(telemetry_page, response, sizeof(response));
+    tud_hid_report(0, response, sizeof(response));
+}
+
+uint16_t read_u16(const uint8_t* data)
+{
+    return static_cast<uint16_t>(data[0] | (data[1] << 8));
+}
+
+void vendor_finish_frame()
+{
+    vendor_stream.header_size = 0;
+    vendor_stream.discarding = false;
+    telemetry_count_vendor_frame();
+}
+
+// Each step returns false when it has to wait for more data or a free queue slot.
+bool vendor_discard(uint32_t available)
+{
+    uint8_t scratch[32];
+    const uint32_t chunk = (vendor_stream.remaining < sizeof(scratch)) ? vendor_stream.remaining : sizeof(scratch);
+    const uint32_t count = (available < chunk) ? available : chunk;
+    if (count == 0 && vendor_stream.remaining != 0) {
+        return false;
+    }
+
+    tud_vendor_read(scratch, count);
+    vendor_stream.remaining = static_cast<uint16_t>(vendor_stream.remaining - count);
+    if (vendor_stream.remaining == 0) {
+        vendor_finish_frame();
+    }
+    return true;
+}
+
+bool vendor_stream_pixels(uint32_t available)
+{
+    VendorStream& stream = vendor_stream;
+    uint8_t* stage = command_queue_stage();
+    if (stage == nullptr) {
+        // The render core has not applied the previous frame yet.
+        return false;
+    }
+
+    if (!stream.offset_read) {
+        if (available < 2) {
+            return false;
+        }
+        uint8_t offset[2];
+        tud_vendor_read(offset, sizeof(offset));
+        stream.pixel_offset = read_u16(offset);
+        stream.remaining = static_cast<uint16_t>(stream.remaining - 2);
+        const uint16_t room =
+            (stream.pixel_offset < MAX_LEDS) ? static_cast<uint16_t>(MAX_LEDS - stream.pixel_offset) : 0;
+        const uint16_t pixels = static_cast<uint16_t>(stream.remaining / 3u);
+        stream.stage_pixels = (pixels < room) ? pixels : room;
+        stream.staged_bytes = 0;
+        stream.offset_read = true;
+        return true;
+    }
+
+    const uint32_t stage_bytes = stream.stage_pixels * 3u;
+    if (stream.staged_bytes < stage_bytes) {
+        const uint32_t missing = stage_bytes - stream.staged_bytes;
+        const uint32_t count = (available < missing) ? available : missing;
+        if (count == 0) {
+            return false;
+        }
+        tud_vendor_read(&stage[stream.staged_bytes], count);
+        stream.staged_bytes = static_cast<uint16_t>(stream.staged_bytes + count);
+        stream.remaining = static_cast<uint16_t>(stream.remaining - count);
+        return true;
+    }
+
+    if (stream.stage_pixels != 0) {
+        if (command_queue_full()) {
+            return false;
+        }
+        HostCommand* slot = command_queue_reserve();
+        slot->command = CMD_INTERNAL_DIRECT_FRAME;
+        slot->payload[0] = static_cast<uint8_t>(stream.pixel_offset & 0xFF);
+        slot->payload[1] = static_cast<uint8_t>(stream.pixel_offset >> 8);
+        slot->payload[2] = static_cast<uint8_t>(stream.stage_pixels & 0xFF);
+        slot->payload[3] = static_cast<uint8_t>(stream.stage_pixels >> 8);
+        slot->payload_size = 4;
+        command_queue_stage_handoff();
+        command_queue_commit();
+        stream.stage_pixels = 0;
+    }
+
+    // Pixels past the LED buffer and a trailing partial pixel are dropped.
+    if (stream.remaining == 0) {
+        vendor_finish_frame();
+    } else {
+        stream.discarding = true;
+    }
+    return true;
+}
+
+bool vendor_stream_command(uint32_t available)
+{
+    VendorStream& stream = vendor_stream;
+    if (stream.command == CMD_PING || stream.command >= CMD_INTERNAL_USB_MOUNTED
+        || stream.remaining > HOST_COMMAND_PAYLOAD_MAX) {
+        if (stream.command == CMD_PING) {
+            tud_vendor_write("PONG", 4);
+            tud_vendor_write_flush();
+        } else {
+            LOGF("Vendor frame 0x%02X length=%u ignored\n", stream.command, stream.remaining);
+        }
+        stream.discarding = true;
+        return true;
+    }
+
+    if (stream.command == CMD_GET_TELEMETRY) {
+        if (available < stream.remaining) {
+            return false;
+        }
+        uint8_t payload[HOST_COMMAND_PAYLOAD_MAX];
+        tud_vendor_read(payload, stream.remaining);
+        uint8_t report[64];
+        telemetry_write_report((stream.remaining > 0) ? payload[0] : TELEMETRY_PAGE_SUMMARY, report, sizeof(report));
+        tud_vendor_write(report, sizeof(report));
+        tud_vendor_write_flush();
+        vendor_finish_frame();
+        return true;
+    }
+
+    if (available < stream.remaining || command_queue_full()) {
+        return false;
+    }
+
+    HostCommand* slot = command_queue_reserve();
+    slot->command = stream.command;
+    slot->payload_size = static_cast<uint8_t>(stream.remaining);
+    if (stream.remaining > 0) {
+        tud_vendor_read(slot->payload, stream.remaining);
+    }
+    command_queue_commit();
+    vendor_finish_frame();
+    return true;
+}
+
+void vendor_service()
+{
+    VendorStream& stream = vendor_stream;
+    bool progress = true;
+    while (progress) {
+        const uint32_t available = tud_vendor_available();
+        if (stream.header_size < sizeof(stream.header)) {
+            if (available == 0) {
+                return;
+            }
+
+            uint8_t byte = 0;
+            tud_vendor_read(&byte, 1);
+            if (stream.header_size == 0 && byte != VENDOR_FRAME_MAGIC) {
+                continue;
+            }
+            stream.header[stream.header_size++] = byte;
+            if (stream.header_size == sizeof(stream.header)) {
+                stream.command = stream.header[1];
+                stream.remaining = read_u16(&stream.header[2]);
+                stream.offset_read = false;
+                stream.discarding = (stream.command == CMD_DIRECT_PIXELS && stream.remaining < 2);
+            }
+            continue;
+        }
+
+        if (stream.discarding) {
+            progress = vendor_discard(available);
+        } else if (stream.command == CMD_DIRECT_PIXELS) {
+            progress = vendor_stream_pixels(available);
+        } else {
+            progress = vendor_stream_command(available);
+        }
+    }
+}
+
+bool push_command(uint8_t command, const uint8_t* payload, uint16_t payload_size)
+{
+    HostCommand* slot = command_queue_reserve();
+    if (slot == nullptr) {
+        return false;
+    }
+
+    if (payload_size > HOST_COMMAND_PAYLOAD_MAX) {
+        payload_size = HOST_COMMAND_PAYLOAD_MAX;
+    }
+    slot->command = command;
+    slot->payload_size = static_cast<uint8_t>(payload_size);
+    if (payload_size > 0) {
+        memcpy(slot->payload, payload, payload_size);
+    }
+    command_queue_commit();
+    return true;
+}
+
+// Queues a latched mount event, so it is applied before anything the host sends next.
+bool flush_usb_event()
+{
+    if (pending_usb_event == 0) {
+        return true;
+    }
+    // Checked first so a deferred event is not counted as a dropped command.
+    if (command_queue_full()) {
+        return false;
+    }
+    push_command(pending_usb_event, nullptr, 0);
+    pending_usb_event = 0;
+    return true;
+}
+
+bool queue_command(uint8_t command, const uint8_t* payload, uint16_t payload_size)
+{
+    return flush_usb_event() && push_command(command, payload, payload_size);
+}
+
+void queue_usb_event(uint8_t command)
+{
+    pending_usb_event = command;
+    if (!flush_usb_event()) {
+        LOGF("USB event 0x%02X deferred: queue full\n", command);
+    }
+}
+
+void handle_hid_report(uint8_t const* buffer, uint16_t bufsize)
+{
+    telemetry_count_hid_report();
+
+    const ParsedHidCommand parsed = protocol_parse_report(buffer, bufsize);
+    if (parsed.payload == nullptr && parsed.command == 0) {
+        LOGF("Empty HID report\n");
+        return;
+    }
+
+    // Pixel streams, spectra and telemetry polls arrive continuously; logging each report would stall USB.
+    if (parsed.command != CMD_DIRECT_PIXELS && parsed.command != CMD_GET_TELEMETRY
+        && parsed.command != CMD_SPECTRUM && parsed.command != CMD_ANIMATION_DATA) {
+        debug_buffer("HID SET_REPORT", buffer, bufsize);
+        debug_blink(1, 20);
+    }
+
+    if (parsed.command == CMD_PING) {
+        send_pong();
+        LOGF("PING -> PONG\n");
+        return;
+    }
+    if (parsed.command == CMD_GET_TELEMETRY) {
+        telemetry_page = (parsed.payload_size > 0) ? parsed.payload[0] : TELEMETRY_PAGE_SUMMARY;
+        send_telemetry();
+        return;
+    }
+    if (parsed.command >= CMD_INTERNAL_USB_MOUNTED) {
+        LOGF("Unknown command 0x%02X\n", parsed.command);
+        return;
+    }
+
+    // Everything else is applied by the render core.
+    if (!queue_command(parsed.command, parsed.payload, parsed.payload_size)) {
+        LOGF("Command 0x%02X dropped: queue full\n", parsed.command);
+    }
+}
+
+} // namespace
+
+void usb_device_service()
+{
+    // Vendor frames wait behind a deferred mount event, like HID commands do.
+    if (flush_usb_event() && tud_vendor_available() > 0) {
+        const uint32_t started_us = time_us_32();
+        vendor_service();
+        telemetry_record(TELEMETRY_USB, started_us);
+    }
+}
+
+} // namespace firmware
+
+uint8_t const* tud_descriptor_device_cb(void)
+{
+    return reinterpret_cast<uint8_t const*>(&firmware::device_descriptor);
+}
+
+uint8_t const* tud_descriptor_bos_cb(void)
+{
+    return firmware::bos_descriptor;
+}
+
+uint8_t const* tud_descriptor_configuration_cb(uint8_t index)
+{
+    (void)index;
+    return firmware::configuration_descriptor;
+}
+
+uint16_t const* tud_descriptor_string_cb(uint8_t index, uint16_t langid)
+{
+    (void)langid;
+
+    uint8_t chr_count = 0;
+    if (index == 0) {
+        firmware::string_descriptor[1] = 0x0409;
+        chr_count = 1;
+    } else {
+        if (index >= sizeof(firmware::string_descriptors) / sizeof(firmware::string_descriptors[0])) {
+            return nullptr;
+        }
+
+        const char* str = firmware::string_descriptors[index];
+        chr_count = static_cast<uint8_t>(strlen(str));
+        if (chr_count > 31) {
+            chr_count = 31;
+        }
+        for (uint8_t i = 0; i < chr_count; i++) {
+            firmware::string_descriptor[1 + i] = static_cast<uint16_t>(str[i]);
+        }
+    }
+
+    firmware::string_descriptor[0] = static_cast<uint16_t>((TUSB_DESC_STRING << 8) | (2 * chr_count + 2));
+    return firmware::string_descriptor;
+}
+
+uint8_t const* tud_hid_descriptor_report_cb(uint8_t instance)
+{
+    (void)instance;
+    return firmware::hid_report_descriptor;
+}
+
+uint16_t tud_hid_get_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_t report_type, uint8_t* buffer, uint16_t reqlen)
+{
+    (void)instance;
+    (void)report_id;
+    (void)report_type;
+    return firmware::telemetry_write_report(firmware::telemetry_page, buffer, reqlen);
+}
+
+void tud_hid_set_report_cb(uint8_t instance, uint8_t report_id, hid_report_type_t report_type, uint8_t const* buffer, uint16_t bufsize)
+{
+    (void)instance;
+    (void)report_id;
+    // Interrupt OUT data comes tagged INVALID or OUTPUT depending on the TinyUSB
+    // version, and SET_REPORT as OUTPUT or FEATURE: all of them carry a command.
+    (void)report_type;
+
+    const uint32_t started_us = time_us_32();
+    firmware::handle_hid_report(buffer, bufsize);
+    firmware::telemetry_record(firmware::TELEMETRY_USB, started_us);
+}
+
+void tud_mount_cb(void)
+{
+    firmware::queue_usb_event(firmware::CMD_INTERNAL_USB_MOUNTED);
+    firmware::debug_blink(2, 40);
+}
+
+void tud_umount_cb(void)
+{
+    firmware::queue_usb_event(firmware::CMD_INTERNAL_USB_UNMOUNTED);
+}
+
+bool tud_vendor_control_xfer_cb(uint8_t rhport, uint8_t stage, tusb_control_request_t const* request)
+{
+    if (stage != CONTROL_STAGE_SETUP) {
+        return true;
+    }
+
+    if (request->bmRequestType_bit.type == TUSB_REQ_TYPE_VENDOR
+        && request->bRequest == firmware::VENDOR_REQUEST_MICROSOFT && request->wIndex == 7) {
+        return tud_control_xfer(rhport, request, const_cast<uint8_t*>(firmware::ms_os_20_descriptor),
+            firmware::MS_OS_20_DESC_LEN);
+    }
+    return false;
+}
+
+// The vendor FIFO is drained by usb_device_service() so it can apply back-pressure.
+void tud_vendor_rx_cb(uint8_t itf, uint8_t const* buffer, uint16_t bufsize)
+{
+    (void)itf;
+    (void)buffer;
+    (void)bufsize;
+}
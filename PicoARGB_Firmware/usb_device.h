@@ -0,0 +1,10 @@
+#pragma once
+
+#include <stdint.h>
+
+namespace firmware {
+
+// Core 0 housekeeping: drains the vendor bulk stream.
+void usb_device_service();
+
+} // namespace firmware